@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * gengram.c: print a synthetic grammar of a given shape and size, for
+ * runbench. usage is:
+ *
+ *      gengram kind n > file.y
+ *
+ * the kinds are:
+ *
+ *      expr      an expression tower with n precedence levels, written out
+ *                as one nonterminal per level (no %left/%right)
+ *      stmt      a statement language with n keywords, each one starting a
+ *                different kind of statement
+ *      nullable  a chain of n nullable nonterminals, each of which can be
+ *                followed by an optional token
+ *      wide      n alternatives that share their first token, so that one
+ *                state has n kernel items and a row with n shifts
+ *
+ * the grammars have no actions, and they're LALR(1). rbison still reports a
+ * shift/reduce conflict or two when one of the tokens gets the value of
+ * WHITESPACE (16), because that's also a lookahead of the start production.
+ */
+
+static void tokens(char *fmt, int n)
+{
+  /* declare the n tokens fmt % 0 .. fmt % n-1, a few to a line */
+
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    if (i % 8 == 0) {
+      printf(i ? "\n%%token" : "%%token");
+    }
+    printf(" ");
+    printf(fmt, i);
+  }
+  printf("\n");
+}
+
+static void expr(int n)
+{
+  int i;
+
+  printf("%%token NUM ID LP RP MINUS\n");
+  tokens("A%d", n);
+  tokens("B%d", n);
+  printf("%%%%\n");
+  printf("goal : e0 ;\n");
+
+  for (i = 0; i < n; ++i) {
+    printf("e%d : e%d A%d e%d | e%d B%d e%d | e%d ;\n", i, i, i, i + 1, i, i, i + 1, i + 1);
+  }
+  printf("e%d : NUM | ID | LP e0 RP | MINUS e%d ;\n", n, n);
+  printf("%%%%\n");
+}
+
+static void stmt(int n)
+{
+  int i;
+
+  printf("%%token NUM ID LP RP LB RB SEMI ASSIGN PLUS STAR COMMA\n");
+  tokens("K%d", n);
+  printf("%%%%\n");
+  printf("goal : stmts ;\n");
+  printf("stmts : stmts stmt | ;\n");
+  printf("stmt : ID ASSIGN expr SEMI\n");
+  printf("     | LB stmts RB\n");
+
+  for (i = 0; i < n; ++i) {
+    switch (i % 5) {
+      case 0: printf("     | K%d expr SEMI\n", i);                      break;
+      case 1: printf("     | K%d LP expr RP stmt\n", i);                break;
+      case 2: printf("     | K%d ID LP args RP SEMI\n", i);             break;
+      case 3: printf("     | K%d stmt K%d LP expr RP SEMI\n", i, i);    break;
+      case 4: printf("     | K%d ID ASSIGN expr COMMA expr SEMI\n", i); break;
+    }
+  }
+  printf("     ;\n");
+
+  printf("args : args COMMA expr | expr | ;\n");
+  printf("expr : expr PLUS term | term ;\n");
+  printf("term : term STAR factor | factor ;\n");
+  printf("factor : NUM | ID | ID LP args RP | LP expr RP ;\n");
+  printf("%%%%\n");
+}
+
+static void nullable(int n)
+{
+  int i;
+
+  printf("%%token END\n");
+  tokens("A%d", n);
+  printf("%%%%\n");
+  printf("goal : n0 END ;\n");
+
+  for (i = 0; i < n; ++i) {
+    printf("n%d : n%d m%d ;\n", i, i + 1, i);
+    printf("m%d : A%d | ;\n", i, i);
+  }
+  printf("n%d : ;\n", n);
+  printf("%%%%\n");
+}
+
+static void wide(int n)
+{
+  int i;
+
+  printf("%%token PRE SEMI COLON\n");
+  tokens("T%d", n);
+  tokens("U%d", n);
+  printf("%%%%\n");
+  printf("goal : list ;\n");
+  printf("list : list item | item ;\n");
+  printf("item : PRE T0 U0\n");
+
+  for (i = 1; i < n; ++i) {
+    printf("     | PRE T%d U%d\n", i, i);
+  }
+  for (i = 0; i < n; ++i) {
+    printf("     | T%d COLON T%d SEMI\n", i, (i + 1) % n);
+  }
+  printf("     ;\n");
+  printf("%%%%\n");
+}
+
+int main(int argc, char *argv[])
+{
+  static struct {
+    char *name;
+    void (*gen)(int n);
+  } kinds[] = {
+    { "expr",     expr     },
+    { "stmt",     stmt     },
+    { "nullable", nullable },
+    { "wide",     wide     },
+  };
+
+  int i, n;
+
+  if (argc != 3 || (n = atoi(argv[2])) <= 0) {
+    fprintf(stderr, "usage: gengram expr|stmt|nullable|wide n\n");
+    exit(1);
+  }
+
+  for (i = 0; i < sizeof(kinds) / sizeof(*kinds); ++i) {
+    if (!strcmp(argv[1], kinds[i].name)) {
+      printf("/* generated by gengram %s %d */\n\n", argv[1], n);
+      (*kinds[i].gen)(n);
+      return 0;
+    }
+  }
+
+  fprintf(stderr, "gengram: unknown kind %s\n", argv[1]);
+  return 1;
+}
@@ -0,0 +1,77 @@
+/* a small statement language, for pbench. the actions add up the values
+ * of the expressions so that they do some work, but nothing is printed.
+ */
+
+%{
+#include <stdio.h>
+
+static int Vars[26];    /* a to z */
+static int Calls = 0;
+%}
+
+%token ID NUM
+%token IF WHILE RETURN
+%token LP RP LB RB SEMI COMMA
+%nonassoc LOWER_THAN_ELSE
+%nonassoc ELSE
+%right ASSIGN
+%left OR
+%left AND
+%left EQ NE
+%left LT GT
+%left PLUS SUB
+%left MUL DIV
+%right NOT UNARY
+
+%%
+
+program : stmts
+        ;
+
+stmts : stmts stmt
+      | /* epsilon */
+      ;
+
+stmt : expr SEMI
+     | IF LP expr RP stmt %prec LOWER_THAN_ELSE
+     | IF LP expr RP stmt ELSE stmt
+     | WHILE LP expr RP stmt
+     | RETURN expr SEMI
+     | LB stmts RB
+     | SEMI
+     ;
+
+expr : ID ASSIGN expr { $$ = Vars[$1] = $3; }
+     | expr OR expr   { $$ = $1 || $3; }
+     | expr AND expr  { $$ = $1 && $3; }
+     | expr EQ expr   { $$ = $1 == $3; }
+     | expr NE expr   { $$ = $1 != $3; }
+     | expr LT expr   { $$ = $1 < $3; }
+     | expr GT expr   { $$ = $1 > $3; }
+     | expr PLUS expr { $$ = $1 + $3; }
+     | expr SUB expr  { $$ = $1 - $3; }
+     | expr MUL expr  { $$ = $1 * $3; }
+     | expr DIV expr  { $$ = $3 ? $1 / $3 : 0; }
+     | SUB expr %prec UNARY { $$ = -$2; }
+     | NOT expr       { $$ = !$2; }
+     | LP expr RP     { $$ = $2; }
+     | ID LP args RP  { $$ = $3; ++Calls; }
+     | ID             { $$ = Vars[$1]; }
+     | NUM
+     ;
+
+args : arglist
+     | /* epsilon */  { $$ = 0; }
+     ;
+
+arglist : arglist COMMA expr { $$ = $1 + $3; }
+        | expr
+        ;
+
+%%
+int main()
+{
+  ii_advance();
+  ii_mark_start();
+  return yyparse();
+}
@@ -0,0 +1,494 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * pbench.c: measure how fast a parser made by rbison runs. it's compiled
+ * once for each grammar and output mode by runparse, in the directory that
+ * holds the parser, and it's run as:
+ *
+ *      pbench shape n [repeat]
+ *
+ * an input of the given shape is made up for the grammar:
+ *
+ *      deep    n levels of nesting: parenthesized subexpressions for the
+ *              test/expr_n grammars, nested if statements and blocks for
+ *              lang.y
+ *      flat    one long list: an expression with n operands, or a call
+ *              with n arguments
+ *      short   n short statements
+ *
+ * and it's parsed "repeat" times (5 by default). the fastest time is printed
+ * as one line of JSON, along with the number of tokens that the parser read
+ * (end of input included), the number of reductions (accept included) and
+ * the deepest that the state stack got.
+ *
+ * by default the tokens come from a stub yylex() that replays a token stream
+ * made in memory, and the ii_ functions that the driver calls are stubs that
+ * hand back the text of the previous token, so only the parser is timed.
+ * compiled with -DRLEX, the input is written to input.txt as text and read by
+ * the real lexer in lex.yy.c instead, which has to be compiled with
+ * -Dyylex=rlex_yylex.
+ *
+ * the test/expr_n grammars parse a single line, so their input is a series
+ * of lines, each one followed by end of input, and yyparse() is called once
+ * for each line. lang.y reads the whole input in one go. pbench only knows
+ * the grammars by the tokens in y.tab.h: EOL means an expr grammar, LP means
+ * that it has parentheses. the value of a NUM is set with SET_NUM(v), which
+ * has to be redefined for a grammar with a %union.
+ *
+ * compiled with -DYYPROFILE, the parser's profile (see yyprofile() in the
+ * driver) is written to profile.txt once the input has been parsed, for
+ * rbison --profile. the times then include the counting.
+ *
+ * what the actions print isn't wanted, so printf() is #defined to a function
+ * that does nothing, and the grammar's main() is renamed. y.act.c, when
+ * there is one, has to be compiled with -Dprintf=pbench_printf and
+ * -Dmain=grammar_main for the same reasons. deep inputs need a bigger stack
+ * than the default, compile with -DYYMAXDEPTH=n.
+ */
+
+int pbench_printf(const char *fmt, ...)
+{
+  return 0;
+}
+
+#define printf pbench_printf
+#define main   grammar_main    /* the grammars all have their own */
+
+#include "y.tab.c"
+
+#undef printf
+#undef main
+
+#ifndef SET_NUM
+#define SET_NUM(v) (yylval = (v))
+#endif
+
+typedef struct _token_ {
+  int tok;                    /* token value, 0 for end of input */
+  int val;                    /* yylval for NUM and ID */
+  int off, len;               /* lexeme in Text[] */
+  int line;
+} TOKEN;
+
+static TOKEN *Toks;           /* the input */
+static int Ntoks = 0;
+static int Maxtoks = 0;
+
+static char *Text;            /* the same input, as text */
+static int Ntext = 0;
+static int Maxtext = 0;
+static int Line = 1;
+
+static void *grow(void *p, int *max, int size)
+{
+  *max = *max ? *max * 2 : 1024;
+  if (!(p = realloc(p, *max * size))) {
+    fprintf(stderr, "pbench: out of memory\n");
+    exit(1);
+  }
+  return p;
+}
+
+static void text(char *str)
+{
+  int len = strlen(str);
+
+  while (Ntext + len + 1 >= Maxtext) {
+    Text = (char *) grow(Text, &Maxtext, 1);
+  }
+  memcpy(Text + Ntext, str, len + 1);
+  Ntext += len;
+}
+
+static void put(int tok, int val, char *lexeme)
+{
+  /* add a token to the input. val is used for NUMs, and for IDs if the
+   * grammar has them. lexeme is the text that the real lexer would read.
+   */
+
+  char buf[32];
+
+  if (Ntoks >= Maxtoks) {
+    Toks = (TOKEN *) grow(Toks, &Maxtoks, sizeof(TOKEN));
+  }
+
+  if (!lexeme) {              /* a NUM */
+    sprintf(buf, "%d", val);
+    lexeme = buf;
+  }
+
+  if (Ntext && Text[Ntext - 1] != '\n') {
+    text(" ");
+  }
+
+  Toks[Ntoks].tok  = tok;
+  Toks[Ntoks].val  = val;
+  Toks[Ntoks].off  = Ntext;
+  Toks[Ntoks].len  = strlen(lexeme);
+  Toks[Ntoks].line = Line;
+  ++Ntoks;
+
+  text(lexeme);
+  if (*lexeme == '\n') {
+    ++Line;
+  }
+}
+
+static void newline()
+{
+  /* end a line of text, without a token */
+
+  text("\n");
+  ++Line;
+}
+
+#define NUMBER(i) put(NUM, (i) % 9 + 1, NULL)   /* never 0, for the divisions */
+
+#ifdef EOL    /* the test/expr_n grammars */
+
+static void op(int i)
+{
+  static int ops[] = { PLUS, MUL, SUB, DIV };
+  static char *lexemes[] = { "+", "*", "-", "/" };
+
+  put(ops[i % 4], 0, lexemes[i % 4]);
+}
+
+static int make_input(char *shape, int n)
+{
+  /* return 0 if the grammar can't be given this shape */
+
+  int i, j;
+
+  if (!strcmp(shape, "deep")) {
+#ifndef LP
+    return 0;
+#else
+    for (i = 0; i < n; ++i) {  /* 1 + (2 + (3 + ... )) */
+      put(LP, 0, "(");
+      NUMBER(i);
+      put(PLUS, 0, "+");
+    }
+    NUMBER(n);
+    for (i = 0; i < n; ++i) {
+      put(RP, 0, ")");
+    }
+    put(EOL, 0, "\n");
+    put(0, 0, "");
+#endif
+  } else if (!strcmp(shape, "flat")) {
+    NUMBER(0);
+    for (i = 1; i < n; ++i) {
+      op(i);
+      NUMBER(i);
+    }
+    put(EOL, 0, "\n");
+    put(0, 0, "");
+  } else if (!strcmp(shape, "short")) {
+    for (i = 0; i < n; ++i) {
+      NUMBER(i);
+      for (j = 1; j < 3; ++j) {
+        op(i + j);
+        NUMBER(i + j);
+      }
+      put(EOL, 0, "\n");
+      put(0, 0, "");
+    }
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+#else         /* lang.y */
+
+static void id(int i)
+{
+  char buf[2];
+
+  buf[0] = 'a' + i % 26;
+  buf[1] = '\0';
+  put(ID, i % 26, buf);
+}
+
+static int make_input(char *shape, int n)
+{
+  int i;
+
+  if (!strcmp(shape, "deep")) {
+    for (i = 0; i < n; ++i) {  /* if (a) { if (b) { ... c = 1; } } */
+      put(IF, 0, "if");
+      put(LP, 0, "(");
+      id(i);
+      put(RP, 0, ")");
+      put(LB, 0, "{");
+    }
+    id(n);
+    put(ASSIGN, 0, "=");
+    NUMBER(n);
+    put(SEMI, 0, ";");
+    for (i = 0; i < n; ++i) {
+      put(RB, 0, "}");
+    }
+  } else if (!strcmp(shape, "flat")) {
+    id(5);                     /* f(1, 2, 3, ...); */
+    put(LP, 0, "(");
+    for (i = 0; i < n; ++i) {
+      if (i) {
+        put(COMMA, 0, ",");
+      }
+      NUMBER(i);
+    }
+    put(RP, 0, ")");
+    put(SEMI, 0, ";");
+  } else if (!strcmp(shape, "short")) {
+    for (i = 0; i < n; ++i) {  /* a = b * 2 + c; */
+      id(i);
+      put(ASSIGN, 0, "=");
+      id(i + 1);
+      put(MUL, 0, "*");
+      NUMBER(i);
+      put(PLUS, 0, "+");
+      id(i + 2);
+      put(SEMI, 0, ";");
+      newline();
+    }
+  } else {
+    return 0;
+  }
+  put(0, 0, "");
+  return 1;
+}
+
+#endif
+
+static int Pos;               /* next token to hand to the parser */
+
+#ifndef RLEX
+
+/* the stub lexer and input system. yylex() hands out the tokens in Toks[].
+ * the driver marks the token that it just shifted with ii_mark_prev(), and
+ * gets its text back with ii_ptext() when it reduces, just as it does with
+ * the real input system.
+ */
+
+char *yytext = "";
+int yyleng;
+int yylineno;
+
+static TOKEN None = { 0, 0, 0, 0, 0 };
+static TOKEN *Cur = &None, *Prev = &None;
+
+int yylex()
+{
+  Cur = &Toks[Pos++];
+  if (Cur->tok == NUM) {
+    SET_NUM(Cur->val);
+  }
+#ifdef ID
+  else if (Cur->tok == ID) {
+    yylval = Cur->val;
+  }
+#endif
+  return Cur->tok;
+}
+
+char *ii_ptext()   { return Prev == &None ? NULL : Text + Prev->off; }
+int ii_plength()   { return Prev->len; }
+int ii_plineno()   { return Prev->line; }
+char *ii_mark_prev() { Prev = Cur; return Text + Prev->off; }
+
+int ii_advance()   { return 0; }   /* used by grammar_main(), which isn't */
+char *ii_mark_start() { return Text; }
+
+static void start()
+{
+  Pos = 0;
+  Cur = Prev = &None;
+}
+
+#else
+
+/* the real lexer. the expr grammars want end of input after each line, so
+ * it's faked after each EOL.
+ */
+
+int rlex_yylex(void);
+
+static int Eoi = 0;
+
+int yylex()
+{
+  int tok;
+
+  if (Eoi) {
+    Eoi = 0;
+    tok = 0;
+  } else {
+    tok = rlex_yylex();
+#ifdef EOL
+    Eoi = (tok == EOL);
+#endif
+  }
+
+  ++Pos;
+  return tok;
+}
+
+static void start()
+{
+  static int started = 0;
+
+  ii_unterm();                  /* ii_newfile() doesn't forget a '\0' that's still in place */
+  if (ii_newfile("input.txt") < 0) {
+    perror("input.txt");
+    exit(1);
+  }
+  if (!started++) {             /* skip the newline that the first ii_advance() makes up */
+    ii_advance();
+    ii_mark_start();
+  }
+  Pos = 0;
+  Eoi = 0;
+}
+
+#endif
+
+static void census(long *reductions, int *peak)
+{
+  /* run the token stream through the state machine, without the driver or
+   * the actions, to count the reductions and find the deepest stack. exit
+   * if the input isn't accepted.
+   */
+
+  int *stack, sp, act, prod, pos = 0;
+
+  *reductions = 0;
+  *peak = 0;
+
+  if (!(stack = (int *) malloc((Ntoks + 2) * sizeof(int)))) {
+    fprintf(stderr, "pbench: out of memory\n");
+    exit(1);
+  }
+
+  while (pos < Ntoks) {
+    stack[sp = 0] = 0;
+    for (;;) {
+      if (sp + 1 > *peak) {
+        *peak = sp + 1;
+      }
+      if ((act = yy_next(Yy_action, stack[sp], Toks[pos].tok)) == YYF) {
+        fprintf(stderr, "pbench: syntax error at token %d\n", pos);
+        exit(1);
+      }
+      if (YY_IS_SHIFT(act)) {
+        stack[++sp] = act;
+        ++pos;
+        continue;
+      }
+
+      ++*reductions;
+      if ((prod = -act) == YY_IS_ACCEPT) {
+        ++pos;                  /* the end of input */
+        break;
+      }
+      sp -= Yy_reduce[prod];
+      act = yy_next(Yy_goto, stack[sp], Yy_lhs[prod]);
+      stack[++sp] = act;
+    }
+  }
+
+  free(stack);
+}
+
+static double now_ns()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+  char *shape;
+  double t, best = -1;
+  long reductions;
+  int n, repeat = 5, peak, i;
+
+  if (argc < 3 || (n = atoi(argv[2])) <= 0) {
+    fprintf(stderr, "usage: pbench deep|flat|short n [repeat]\n");
+    exit(1);
+  }
+  shape = argv[1];
+  if (argc > 3 && (repeat = atoi(argv[3])) < 1) {
+    repeat = 1;
+  }
+
+  if (!make_input(shape, n)) {
+    fprintf(stderr, "pbench: this grammar can't have a %s input\n", shape);
+    exit(2);
+  }
+
+#ifdef YYTABFILE
+  if (yy_load_tables(NULL)) {   /* census() needs the tables before yyparse() loads them */
+    exit(1);
+  }
+#endif
+
+  census(&reductions, &peak);
+  if (peak >= YYMAXDEPTH) {
+    fprintf(stderr, "pbench: the stack gets %d deep, compile with -DYYMAXDEPTH=%d or more\n",
+            peak, peak + 1);
+    exit(1);
+  }
+
+#ifdef RLEX
+  {
+    FILE *fp;
+
+    if (!(fp = fopen("input.txt", "w")) || fwrite(Text, 1, Ntext, fp) != Ntext || fclose(fp)) {
+      perror("input.txt");
+      exit(1);
+    }
+  }
+#endif
+
+  for (i = 0; i < repeat; ++i) {
+    start();
+    t = now_ns();
+    while (Pos < Ntoks) {
+      if (yyparse()) {
+        fprintf(stderr, "pbench: the parser rejected the input\n");
+        exit(1);
+      }
+    }
+    t = now_ns() - t;
+
+    if (best < 0 || t < best) {
+      best = t;
+    }
+  }
+
+#ifdef YYPROFILE
+  {
+    FILE *fp;
+
+    if (!(fp = fopen("profile.txt", "w"))) {
+      perror("profile.txt");
+      exit(1);
+    }
+    yyprofile(fp);
+    fclose(fp);
+  }
+#endif
+
+  fprintf(stdout, "{\"tokens\": %d, \"reductions\": %ld, \"peak_depth\": %d, \"best_ns\": %.0f, "
+                  "\"tokens_per_sec\": %.0f, \"reductions_per_sec\": %.0f, \"ns_per_token\": %.2f}\n",
+          Ntoks, reductions, peak, best, Ntoks / (best / 1e9), reductions / (best / 1e9),
+          best / Ntoks);
+  return 0;
+}
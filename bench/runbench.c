@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+/*
+ * runbench.c: run rbison on a suite of grammars and print the results as
+ * JSON. usage is:
+ *
+ *      runbench [-r rbison] [-n repeat] [-j threads] [-o file]
+ *
+ * it's meant to be run from the bench directory (make bench does that): the
+ * grammars are made by ./gengram or read from this directory, and each one
+ * is processed in its own directory under work/. every grammar is run
+ * through rbison "repeat" times (3 by default); the fastest wall-clock time
+ * is reported along with the largest resident set size, and the time that
+ * the fastest run spent in each phase (from rbison --stats=json). one more
+ * run with -v collects the grammar and state-machine statistics from
+ * rbison's own output. -j is passed on to rbison.
+ */
+
+#define WORK_DIR "work"
+
+typedef struct _case_ {
+  char *kind;             /* gengram kind, or the name of a .y file here */
+  int n;                  /* size passed to gengram, 0 for a .y file */
+} CASE;
+
+static CASE Suite[] = {
+  { "expr",      4 }, { "expr",      16 }, { "expr",      64 },
+  { "stmt",      8 }, { "stmt",      32 }, { "stmt",     128 },
+  { "nullable",  8 }, { "nullable",  32 }, { "nullable", 128 },
+  { "wide",     16 }, { "wide",      64 }, { "wide",     256 },
+  { "ansic.y",   0 },
+};
+
+typedef struct _stats_ {  /* read from the output of rbison -v */
+  char *label;            /* what follows the number on the line */
+  char *key;              /* JSON name */
+  long value;             /* -1 if the line wasn't found */
+} STATS;
+
+static STATS Stats[] = {
+  { "terminals",               "terminals",    -1 },
+  { "nonterminals",            "nonterminals", -1 },
+  { "productions",             "productions",  -1 },
+  { "LALR(1) states",          "states",       -1 },
+  { "items",                   "items",        -1 },
+  { "shift/reduce conflicts",  "sr_conflicts", -1 },
+  { "reduce/reduce conflicts", "rr_conflicts", -1 },
+};
+
+#define NSTATS (sizeof(Stats) / sizeof(*Stats))
+
+static char *Phases[] = {   /* as printed by rbison --stats=json */
+  "parse", "first", "patch", "lr", "reductions", "tables", "driver",
+};
+
+#define NPHASES (sizeof(Phases) / sizeof(*Phases))
+
+static char *Rbison = "../src/rbison";
+static char *Threads = NULL;  /* -j argument for rbison */
+
+static double now_ms()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int run(char *dir, char *grammar, int verbose, char *out, char *err, struct rusage *ru)
+{
+  /* run rbison on grammar in dir, with stdout going to the file out. if err
+   * isn't NULL, rbison is run with --stats=json and stderr goes to the file
+   * err, otherwise it's discarded. return the exit status, -1 if rbison
+   * couldn't be run.
+   */
+
+  char *argv[6];
+  int argc = 0;
+  int status, fd;
+  pid_t pid;
+
+  argv[argc++] = Rbison;
+  if (verbose) {
+    argv[argc++] = "-v";
+  }
+  if (Threads) {
+    argv[argc++] = Threads;
+  }
+  if (err) {
+    argv[argc++] = "--stats=json";
+  }
+  argv[argc++] = grammar;
+  argv[argc] = NULL;
+
+  if ((pid = fork()) < 0) {
+    perror("fork");
+    exit(1);
+  }
+
+  if (pid == 0) {
+    if (chdir(dir) < 0 || (fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+      _exit(127);
+    }
+    dup2(fd, 1);
+    if ((fd = open(err ? err : "/dev/null", O_WRONLY | O_CREAT | O_TRUNC, 0644)) >= 0) {
+      dup2(fd, 2);
+    }
+    execv(Rbison, argv);
+    _exit(127);
+  }
+
+  if (wait4(pid, &status, 0, ru) < 0) {
+    perror("wait4");
+    exit(1);
+  }
+
+  if (!WIFEXITED(status) || WEXITSTATUS(status) == 127) {
+    return -1;
+  }
+  return WEXITSTATUS(status);
+}
+
+static void read_stats(char *file)
+{
+  /* pick the statistics out of the output of rbison -v */
+
+  char line[256], label[256];
+  FILE *fp;
+  long value;
+  int i;
+
+  for (i = 0; i < NSTATS; ++i) {
+    Stats[i].value = -1;
+  }
+
+  if (!(fp = fopen(file, "r"))) {
+    return;
+  }
+
+  while (fgets(line, sizeof(line), fp)) {  /* "%4d  label[, more]" */
+    if (sscanf(line, "%ld %255[^\n,]", &value, label) != 2) {
+      continue;
+    }
+    for (i = 0; i < NSTATS; ++i) {
+      if (Stats[i].value < 0 && !strcmp(label, Stats[i].label)) {
+        Stats[i].value = value;
+      }
+    }
+  }
+
+  fclose(fp);
+}
+
+static void read_phases(char *file, double *wall)
+{
+  /* pick the wall-clock time of each phase out of the output of
+   * rbison --stats=json. a phase that isn't found gets -1.
+   */
+
+  char buf[8192], key[64], *p;
+  FILE *fp;
+  int i, n = 0;
+
+  if ((fp = fopen(file, "r"))) {   /* the stats come last, after the LR: progress line */
+    if (fseek(fp, -(long) (sizeof(buf) - 1), SEEK_END) < 0) {
+      rewind(fp);
+    }
+    n = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+  }
+  buf[n] = '\0';
+
+  for (i = 0; i < NPHASES; ++i) {
+    sprintf(key, "\"%s\": {\"wall_ms\": ", Phases[i]);
+    if (!(p = strstr(buf, key)) || sscanf(p + strlen(key), "%lf", &wall[i]) != 1) {
+      wall[i] = -1;
+    }
+  }
+}
+
+static void bench(FILE *out, CASE *c, int repeat, int first)
+{
+  char dir[256], grammar[PATH_MAX], cmd[PATH_MAX * 2];
+  char path[PATH_MAX];
+  struct rusage ru;
+  struct stat st;
+  double start, wall, best = -1, cpu = 0;
+  double phases[NPHASES];
+  long rss = 0;
+  int i, status = 0;
+
+  if (c->n) {
+    sprintf(dir, "%s/%s-%d", WORK_DIR, c->kind, c->n);
+  } else {
+    sprintf(dir, "%s/%.*s", WORK_DIR, (int) strcspn(c->kind, "."), c->kind);
+  }
+  mkdir(WORK_DIR, 0755);
+  mkdir(dir, 0755);
+
+  if (c->n) {
+    snprintf(grammar, sizeof(grammar), "%s/grammar.y", dir);
+    snprintf(cmd, sizeof(cmd), "./gengram %s %d > %s", c->kind, c->n, grammar);
+    if (system(cmd) != 0) {
+      fprintf(stderr, "runbench: can't make %s\n", grammar);
+      exit(1);
+    }
+  } else {
+    strcpy(grammar, c->kind);
+  }
+
+  if (!realpath(grammar, path)) {   /* rbison runs in dir */
+    perror(grammar);
+    exit(1);
+  }
+
+  fprintf(stderr, "%s %d:", c->kind, c->n);
+  for (i = 0; i < repeat && status == 0; ++i) {
+    start = now_ms();
+    status = run(dir, path, 0, "stdout.txt", "stats.txt", &ru);
+    wall = now_ms() - start;
+
+    if (best < 0 || wall < best) {
+      best = wall;
+      snprintf(cmd, sizeof(cmd), "%s/stats.txt", dir);
+      read_phases(cmd, phases);
+      cpu = ru.ru_utime.tv_sec * 1000.0 + ru.ru_utime.tv_usec / 1000.0
+          + ru.ru_stime.tv_sec * 1000.0 + ru.ru_stime.tv_usec / 1000.0;
+    }
+    if (ru.ru_maxrss > rss) {
+      rss = ru.ru_maxrss;
+    }
+    fprintf(stderr, " %.1fms", wall);
+  }
+  fprintf(stderr, status ? " (exit %d)\n" : "\n", status);
+
+  snprintf(cmd, sizeof(cmd), "%s/y.tab.c", dir);
+  if (status != 0 || stat(cmd, &st) < 0) {
+    st.st_size = -1;
+  }
+
+  if (status == 0 && run(dir, path, 1, "verbose.txt", NULL, &ru) == 0) {
+    snprintf(cmd, sizeof(cmd), "%s/verbose.txt", dir);
+    read_stats(cmd);
+  } else {
+    read_stats("");
+  }
+
+  fprintf(out, "%s    {\"grammar\": \"%s\", \"n\": %d, \"exit\": %d,\n", first ? "" : ",\n",
+          c->kind, c->n, status);
+  fprintf(out, "     \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"max_rss_kb\": %ld, \"output_bytes\": %ld",
+          best, cpu, rss, (long) st.st_size);
+
+  for (i = 0; i < NSTATS; ++i) {
+    fprintf(out, i % 4 ? ", " : ",\n     ");
+    fprintf(out, "\"%s\": %ld", Stats[i].key, Stats[i].value);
+  }
+
+  fprintf(out, ",\n     \"phase_ms\": {");
+  for (i = 0; i < NPHASES; ++i) {
+    fprintf(out, "%s\"%s\": %.3f", i ? ", " : "", Phases[i], phases[i]);
+  }
+  fprintf(out, "}}");
+}
+
+int main(int argc, char *argv[])
+{
+  FILE *out = stdout;
+  int repeat = 3;
+  int i, c;
+
+  while ((c = getopt(argc, argv, "r:n:j:o:")) != -1) {
+    switch (c) {
+      case 'r': Rbison = optarg;                  break;
+      case 'n': repeat = atoi(optarg);            break;
+      case 'j': Threads = malloc(strlen(optarg) + 3);
+                sprintf(Threads, "-j%s", optarg); break;
+      case 'o':
+        if (!(out = fopen(optarg, "w"))) {
+          perror(optarg);
+          exit(1);
+        }
+        break;
+      default:
+        fprintf(stderr, "usage: runbench [-r rbison] [-n repeat] [-j threads] [-o file]\n");
+        exit(1);
+    }
+  }
+
+  if (repeat < 1) {
+    repeat = 1;
+  }
+
+  if (access(Rbison, X_OK) < 0 || !(Rbison = realpath(Rbison, NULL))) {  /* it runs in work/ */
+    perror(Rbison);
+    exit(1);
+  }
+
+  fprintf(out, "{\"rbison\": \"%s\", \"threads\": \"%s\", \"repeat\": %d, \"results\": [\n",
+          Rbison, Threads ? Threads + 2 : "", repeat);
+
+  for (i = 0; i < sizeof(Suite) / sizeof(*Suite); ++i) {
+    bench(out, &Suite[i], repeat, i == 0);
+  }
+
+  fprintf(out, "\n]}\n");
+  if (out != stdout) {
+    fclose(out);
+  }
+  return 0;
+}
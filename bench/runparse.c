@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+/*
+ * runparse.c: measure the speed of the parsers that rbison makes, and print
+ * the results as JSON. usage is:
+ *
+ *      runparse [-r rbison] [-c compiler] [-n repeat] [-l] [-o file]
+ *
+ * it's meant to be run from the bench directory (make parse does that).
+ * each grammar below (test/expr_1 to test/expr_5 and lang.y) is run through
+ * rbison in each output mode, in its own directory under work/parse/, and
+ * compiled together with pbench.c. pbench is then run on each input shape
+ * and size (see pbench.c) and reports tokens and reductions per second,
+ * nanoseconds per token and the deepest that the parser's stack got. a
+ * shape that a grammar can't have (deep, for expr_1, which has no
+ * parentheses) is reported with an exit status of 2.
+ *
+ * the prof mode is the tab mode made with a profile: the parser is first
+ * made without one and compiled with -DYYPROFILE, pbench is run on the
+ * TRAIN shape to write profile.txt, and rbison is then run again with
+ * --profile=profile.txt. the parser that is timed doesn't count anything.
+ *
+ * the arena mode is the tab mode compiled with -DYYARENA. only expr_5 uses
+ * the arena, its actions build a tree and get the nodes from it rather than
+ * from malloc(), so that's the grammar to compare with tab.
+ *
+ * the parsers are compiled with -DYYLAZY, none of the actions call anything
+ * that reads yytext. the tokens come from pbench's stub lexer, so only the
+ * parser is timed. -l
+ * times each parser with its real lexer as well; that needs rlex, which is
+ * run on the .l file that goes with the grammar. -c gives the compiler and
+ * its flags ("gcc -O2" by default), -n is passed on to pbench.
+ */
+
+#define WORK_DIR  "work"
+#define PARSE_DIR "work/parse"
+#define TOP       "../../../.."   /* the repository, from a directory in PARSE_DIR */
+#define MAXDEPTH  100000          /* YYMAXDEPTH for the parsers */
+#define TRAIN     "short 1000"    /* the input that the prof mode's profile is made with */
+
+typedef struct _grammar_ {
+  char *name;
+  char *file;             /* the grammar, relative to the repository */
+  char *lex;              /* the lexer that goes with it */
+  char *cflags;           /* for pbench */
+} GRAMMAR;
+
+static GRAMMAR Grammars[] = {
+  { "expr_1", "test/expr_1.y", "test/expr_1.l", "" },
+  { "expr_2", "test/expr_2.y", "test/expr_2.l", "" },
+  { "expr_3", "test/expr_3.y", "test/expr_3.l", "" },
+  { "expr_4", "test/expr_4.y", "test/expr_4.l", "" },
+  { "expr_5", "test/expr_5.y", "test/expr_5.l", "'-DSET_NUM(v)=(yylval.d = (v))'" },
+  { "lang",   "bench/lang.y",  "bench/lang.l",  "" },
+};
+
+typedef struct _mode_ {   /* an output mode */
+  char *name;
+  char *opts[2];          /* rbison is run once for each of these */
+  char *srcs;             /* what it makes, besides y.tab.c */
+  int train;              /* make profile.txt first */
+  char *cflags;           /* for pbench */
+} MODE;
+
+static MODE Modes[] = {
+  { "tab",   { "",   NULL }, ""          },   /* everything in y.tab.c */
+  { "outab", { "-T", NULL }, "y.outab.c" },   /* tables in y.outab.c */
+  { "split", { "-a", "-p" }, "y.act.c"   },   /* actions in y.act.c */
+  { "prof",  { "--profile=profile.txt", NULL }, "", 1 },  /* tab, ordered by a profile */
+  { "bin",   { "-b", NULL }, ""          },   /* tables mapped from y.tab.bin */
+  { "incbin", { "-B", NULL }, ""         },   /* y.tab.bin built in by the assembler */
+  { "arena", { "",   NULL }, "", 0, "-DYYARENA" },  /* tab, actions allocate from YYARENA */
+};
+
+typedef struct _shape_ {
+  char *name;
+  int n;
+} SHAPE;
+
+static SHAPE Shapes[] = {
+  { "deep",  100 }, { "deep",  1000 },
+  { "flat", 1000 }, { "flat", 10000 },
+  { "short", 1000 }, { "short", 10000 },
+};
+
+#define NUMELE(a) (sizeof(a) / sizeof(*(a)))
+
+static char *Rbison = "../src/rbison";
+static char *Cc = "gcc -O2";
+static int Repeat = 5;
+
+static int shell(char *cmd)
+{
+  /* run cmd with /bin/sh, return its exit status or -1 */
+
+  int status = system(cmd);
+
+  if (status == -1 || !WIFEXITED(status)) {
+    return -1;
+  }
+  return WEXITSTATUS(status);
+}
+
+static int rbison(char *dir, GRAMMAR *g, char *opts)
+{
+  char cmd[PATH_MAX * 4];
+
+  snprintf(cmd, sizeof(cmd), "cd %s && %s %s %s/%s > rbison.txt 2>&1", dir, Rbison, opts, TOP, g->file);
+  if (shell(cmd) != 0) {
+    fprintf(stderr, "runparse: rbison failed, see %s/rbison.txt\n", dir);
+    return 1;
+  }
+  return 0;
+}
+
+static int compile(char *dir, GRAMMAR *g, MODE *m, int rlex, char *cflags, char *out)
+{
+  /* compile pbench, with the parser in dir, into out */
+
+  char cmd[PATH_MAX * 4];
+
+  snprintf(cmd, sizeof(cmd), "cd %s && %s -w -I. -I%s/include -DYYMAXDEPTH=%d -DYYLAZY %s %s %s"
+                             " -Dprintf=pbench_printf -Dmain=grammar_main -o %s"
+                             " %s/bench/pbench.c %s %s %s/lib/libl.a > cc.txt 2>&1",
+           dir, Cc, TOP, MAXDEPTH, rlex ? "-DRLEX" : "", g->cflags, cflags,
+           out, TOP, m->srcs, rlex ? "lex.yy.o" : "", TOP);
+  if (shell(cmd) != 0) {
+    fprintf(stderr, "runparse: can't compile %s, see %s/cc.txt\n", out, dir);
+    return 1;
+  }
+  return 0;
+}
+
+static int build(char *dir, GRAMMAR *g, MODE *m, int rlex)
+{
+  /* make the parser for g in mode m and compile pbench with it, in dir.
+   * return 0 if all went well.
+   */
+
+  char cmd[PATH_MAX * 4];
+  int i;
+
+  mkdir(WORK_DIR, 0755);
+  mkdir(PARSE_DIR, 0755);
+  mkdir(dir, 0755);
+
+  if (m->train) {
+    snprintf(cmd, sizeof(cmd), "cd %s && ./ptrain %s 1 > train.txt 2>&1", dir, TRAIN);
+    if (rbison(dir, g, "") || compile(dir, g, m, 0, "-DYYPROFILE", "ptrain")) {
+      return 1;
+    }
+    if (shell(cmd) != 0) {
+      fprintf(stderr, "runparse: can't make the profile, see %s/train.txt\n", dir);
+      return 1;
+    }
+  }
+
+  for (i = 0; i < NUMELE(m->opts) && m->opts[i]; ++i) {
+    if (rbison(dir, g, m->opts[i])) {
+      return 1;
+    }
+  }
+
+  if (rlex) {
+    snprintf(cmd, sizeof(cmd), "cd %s && rlex -l %s/%s > rlex.txt 2>&1"
+                               " && %s -w -c -I. -I%s/include -Dyylex=rlex_yylex lex.yy.c >> rlex.txt 2>&1",
+             dir, TOP, g->lex, Cc, TOP);
+    if (shell(cmd) != 0) {
+      fprintf(stderr, "runparse: can't make the lexer, see %s/rlex.txt\n", dir);
+      return 1;
+    }
+  }
+
+  return compile(dir, g, m, rlex, m->cflags ? m->cflags : "", "pbench");
+}
+
+static void bench(FILE *out, GRAMMAR *g, MODE *m, int rlex, int *first)
+{
+  char dir[256], cmd[PATH_MAX * 2], line[512], *p;
+  FILE *fp;
+  int i, built, status = -1;
+
+  snprintf(dir, sizeof(dir), "%s/%s-%s%s", PARSE_DIR, g->name, m->name, rlex ? "-rlex" : "");
+  built = !build(dir, g, m, rlex);
+
+  for (i = 0; i < NUMELE(Shapes); ++i) {
+    fprintf(stderr, "%s %s%s %s %d:", g->name, m->name, rlex ? " rlex" : "",
+            Shapes[i].name, Shapes[i].n);
+    line[0] = '\0';
+
+    if (built) {
+      snprintf(cmd, sizeof(cmd), "cd %s && ./pbench %s %d %d > result.txt 2> error.txt",
+               dir, Shapes[i].name, Shapes[i].n, Repeat);
+      status = shell(cmd);
+
+      snprintf(cmd, sizeof(cmd), "%s/result.txt", dir);
+      if (status == 0 && (fp = fopen(cmd, "r"))) {
+        if (!fgets(line, sizeof(line), fp)) {
+          line[0] = '\0';
+        }
+        fclose(fp);
+      }
+    }
+
+    /* pbench prints {...}, its fields are added to ours */
+
+    if ((p = strchr(line, '{'))) {
+      p[strcspn(p, "}")] = '\0';
+      fprintf(stderr, " %s\n", p + 1);
+    } else {
+      fprintf(stderr, status == 2 ? " (not for this grammar)\n" : " (exit %d)\n", status);
+    }
+
+    fprintf(out, "%s    {\"grammar\": \"%s\", \"mode\": \"%s\", \"lexer\": \"%s\", \"shape\": \"%s\", "
+                 "\"n\": %d, \"exit\": %d", *first ? "" : ",\n", g->name, m->name,
+            rlex ? "rlex" : "stub", Shapes[i].name, Shapes[i].n, status);
+    if (p) {
+      fprintf(out, ",\n     %s", p + 1);
+    }
+    fprintf(out, "}");
+    *first = 0;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  FILE *out = stdout;
+  int rlex = 0, first = 1;
+  int i, j, c;
+
+  while ((c = getopt(argc, argv, "r:c:n:lo:")) != -1) {
+    switch (c) {
+      case 'r': Rbison = optarg;         break;
+      case 'c': Cc = optarg;             break;
+      case 'n': Repeat = atoi(optarg);   break;
+      case 'l': rlex = 1;                break;
+      case 'o':
+        if (!(out = fopen(optarg, "w"))) {
+          perror(optarg);
+          exit(1);
+        }
+        break;
+      default:
+        fprintf(stderr, "usage: runparse [-r rbison] [-c compiler] [-n repeat] [-l] [-o file]\n");
+        exit(1);
+    }
+  }
+
+  if (Repeat < 1) {
+    Repeat = 1;
+  }
+
+  if (access(Rbison, X_OK) < 0 || !(Rbison = realpath(Rbison, NULL))) {  /* it runs in work/ */
+    perror(Rbison);
+    exit(1);
+  }
+
+  fprintf(out, "{\"rbison\": \"%s\", \"cc\": \"%s\", \"repeat\": %d, \"results\": [\n",
+          Rbison, Cc, Repeat);
+
+  for (i = 0; i < NUMELE(Grammars); ++i) {
+    for (j = 0; j < NUMELE(Modes); ++j) {
+      bench(out, &Grammars[i], &Modes[j], 0, &first);
+      if (rlex) {
+        bench(out, &Grammars[i], &Modes[j], 1, &first);
+      }
+    }
+  }
+
+  fprintf(out, "\n]}\n");
+  if (out != stdout) {
+    fclose(out);
+  }
+  return 0;
+}
@@ -12,6 +12,7 @@
 
 /* ---------------- lib/ferr.c ---------------- */
 int ferr(char *fmt, ...);
+extern void (*On_ferr)(char *msg);  /* called by ferr() instead of exit(), mustn't return */
 
 /* ---------------- lib/printv.c ---------------- */
 void printv(FILE *fp, char *argv[]);
@@ -25,8 +26,38 @@ int oct2bin(int c);
 int esc(char **s);
 char *bin_to_ascii(int c, int use_hex);
 
+/* ---------------- lib/memory.c ---------------- */
+#define MEM_OTHER   0     /* categories used by the library */
+#define MEM_SETS    1     /* lib/set.c */
+#define MEM_HASH    2     /* hash-table slots, lib/hash.c */
+#define MEM_SYMBOLS 3     /* newsym() */
+#define MEM_USER    4     /* the first one that a program can use */
+#define MEM_MAXCAT  16
+#define MEM_TOTAL   (-1)  /* all of them, for mem_stats() */
+#define MEM_NONE    (-2)  /* not charged to anything, see newsym() */
+
+void *mem_alloc(int cat, size_t size);
+void *mem_calloc(int cat, size_t n, size_t size);
+void *mem_realloc(int cat, void *p, size_t size);
+char *mem_strdup(int cat, char *str);
+void mem_free(void *p);
+void mem_charge(int cat, long bytes);
+void mem_name(int cat, char *name);
+int mem_stats(int cat, char **name, long *cur, long *peak, long *nallocs);
+long mem_mark(void);
+long mem_mark_peak(void);
+void mem_track(int on);
+void mem_release(void);
+
 /* ---------------- lib/driver.c ---------------- */
+typedef struct _template_ {   /* a driver template compiled into the program */
+  char *name;                 /* template-file name, used in #line directives */
+  char **lines;               /* NULL-terminated sections, with #line directives */
+  char **nolines;             /* the same sections without #line directives */
+} TEMPLATE;
+
 FILE *driver_1(FILE *output, int lines, char *file_name);
+void driver_1t(FILE *output, int lines, TEMPLATE *tmpl);
 int driver_2(FILE *output, int lines);
 
 #endif
\ No newline at end of file
@@ -1,17 +1,43 @@
 #ifndef _HASH_H
 #define _HASH_H
 
+/*
+ * open-addressing hash table. every symbol is preceded by a BUCKET, which
+ * is allocated by newsym(). the table itself is an array of slots (a power of
+ * two in size) that is probed linearly. each slot holds the cached hash value
+ * of its symbol, so most mismatches are found without calling cmp(). the
+ * symbols are also linked together in the order that they were added, and
+ * that's the order in which an unsorted ptab() visits them.
+ */
+
 typedef struct BUCKET {
-  struct BUCKET *next;
-  struct BUCKET **prev;
+  struct BUCKET *next;    /* next symbol in insertion order */
+  struct BUCKET **prev;   /* link that points at this symbol */
+  unsigned int hval;      /* cached hash value */
 } BUCKET;
 
+#define HASH_HIST 8       /* probe-length histogram size, the last entry counts longer probes */
+
+typedef struct hash_slot_ {
+  unsigned int hval;      /* hash value of sym (valid if sym is a symbol) */
+  BUCKET *sym;            /* NULL if empty, HASH_TOMBSTONE if deleted */
+} HASH_SLOT;
+
 typedef struct hash_tab_ {
-  int size;
-  int numsyms;
+  int size;               /* # of slots, a power of two */
+  int shift;              /* 32 - log2(size), used to pick the first slot */
+  int numsyms;            /* # of symbols in the table */
+  int used;               /* # of slots that aren't empty (symbols and tombstones) */
   unsigned int (*hash) (void *);
   int (*cmp)(void *, void *);
-  BUCKET *table[1];
+  HASH_SLOT *table;       /* the slots */
+  BUCKET *first;          /* symbols in insertion order */
+  BUCKET **last;          /* &next field of the most recently added symbol */
+
+  long lookups;           /* statistics: # of findsym() calls */
+  long probes;            /* # of occupied slots examined by findsym() */
+  long compares;          /* # of calls to cmp() made by findsym() */
+  long hist[HASH_HIST];   /* hist[n]: # of findsym() calls that examined n occupied slots */
 } HASH_TAB;
 
 typedef void (*ptab_t) (void *, ...);
@@ -19,6 +45,8 @@ typedef void (*ptab_t) (void *, ...);
 HASH_TAB *maketab(unsigned int maxsym, unsigned int (*hash) (), int (*cmp)());
 
 void *newsym(unsigned int size);
+void *newsym_in(int cat, unsigned int size);
+void newsym_reset(void);
 void freesym(void *sym);
 
 void *addsym(HASH_TAB *tabp, void *sym);
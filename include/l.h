@@ -42,6 +42,7 @@ void yy_init_lex();
 
 /* ---------------- ferr.c ---------------- */
 int ferr(char *fmt, ...);
+extern void (*On_ferr)(char *msg);  /* called by ferr() instead of exit(), mustn't return */
 
 /* ---------------- yyinitox.c -------------*/
 void yy_init_rbison(void *tos);
@@ -9,6 +9,8 @@ typedef struct _set_
 {
   unsigned int nsize;             /* # size of map */
   unsigned char compl;            /* is a negative true set if true */
+  unsigned char borrowed;         /* map belongs to the caller (see initset()) */
+  unsigned char interned;         /* canonical copy made by intern(), don't change it */
   unsigned int nbits;             /* number of bits in map */
   unsigned int *map;              /* pointer to the map */
   unsigned int defmap[_DEFSIZE];  /* the map itself */
@@ -18,8 +20,13 @@ typedef int (*pset_t) (void* param, char *fmt, ...);
 int _addset(SET* , int );
 void delset(SET*);
 SET *dupset(SET*);
+void initset(SET*, unsigned int*, int);
+SET *intern(SET*);
+void intern_reset(void);
+void intern_stats(long*, long*, int*, long*);
 void invert(SET*);
 SET *newset();
+int next_after(SET*, int);
 int next_member(SET*);
 int num_ele(SET*);
 void pset(SET*, pset_t, void*); /* pset(set, fprintf, stdout ); */
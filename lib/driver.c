@@ -7,30 +7,53 @@ static FILE *Input_file = NULL;
 static int Input_line;              /* line number of most-recently read line */
 static char File_name[128];         /* template-file name */
 
+static TEMPLATE *Builtin = NULL;    /* compiled-in template, used instead of Input_file */
+static int Section;                 /* next section of Builtin to print */
 
 FILE *driver_1(FILE *output, int lines, char *file_name)
 {
-  char install_path[128] = "/usr/local/lib64/";
+  /* the template is opened as given (-m<file>), there's no search path */
 
   if (!(Input_file = fopen(file_name, "r"))) {
-    file_name = strcat(install_path, file_name);
-
-    if (!(Input_file = fopen(file_name, "r"))) {
-      return NULL;
-    }
+    return NULL;
   }
 
-  strncpy(File_name, file_name, sizeof(File_name) );
+  snprintf(File_name, sizeof(File_name), "%s", file_name);
   Input_line = 0;
+  Builtin = NULL;
   driver_2(output, lines);
   return Input_file;
 }
 
+void driver_1t(FILE *output, int lines, TEMPLATE *tmpl)
+{
+  /* like driver_1(), but the template was compiled into the program (see
+   * src/mkpar.c), so there's no file to find or parse. the sections are
+   * already split, with and without #line directives, and each one is
+   * printed with a single fputs().
+   */
+
+  Builtin = tmpl;
+  Section = 0;
+  driver_2(output, lines);
+}
+
 int driver_2(FILE *output, int lines)
 {
   static char buf[256];
   char *p;
   int processing_comment = 0;
+
+  if (Builtin) {
+    p = (lines ? Builtin->lines : Builtin->nolines)[Section];
+    if (!p) {
+      ferr("internal error [driver_2], no more sections in %s\n", Builtin->name);
+    }
+
+    fputs(p, output);
+    return !Builtin->lines[++Section];
+  }
+
   if (!Input_file) {
     ferr("internal error [driver_2], template file lex.par not open\n");
   }
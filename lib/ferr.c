@@ -1,21 +1,36 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <stdarg.h>
 #include <compiler.h>
 
+void (*On_ferr)(char *msg) = NULL;  /* called by ferr() instead of exit(), mustn't return */
+
 int ferr(char *fmt, ...) 
 {
+  /* print the message (or, if fmt is NULL, the next argument and errno's
+   * message, as perror() does) to stderr and exit. if On_ferr is set, it's
+   * given the message instead.
+   */
+
   va_list args;
+  char msg[256];
 
   va_start(args, fmt);
 
   if (fmt) {
-    fprintf(stderr, fmt, args);
+    vsnprintf(msg, sizeof(msg), fmt, args);
   } else {
-    perror(va_arg(args, char *));
+    snprintf(msg, sizeof(msg), "%s: %s\n", va_arg(args, char *), strerror(errno));
+  }
+  va_end(args);
+
+  if (On_ferr) {
+    (*On_ferr)(msg);
   }
 
+  fputs(msg, stderr);
   exit(errno);
   return 0;
-}
\ No newline at end of file
+}
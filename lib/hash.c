@@ -3,41 +3,161 @@
 #include <string.h>
 #include <limits.h>
 #include <hash.h>
+#include <compiler.h>
+
+/* see hash.h for a description of the table */
+
+static BUCKET Tombstone;                  /* marks a slot whose symbol was deleted */
+#define HASH_TOMBSTONE (&Tombstone)
+
+#define MAXLOAD(size) ((size) / 4 * 3)    /* grow when more slots than this are used */
+
+/*
+ * symbols are carved out of large, zeroed chunks of memory. they're never
+ * given back individually: freesym() does nothing, and the memory is
+ * released when the program exits (or by mem_release(), see newsym_reset()).
+ * big symbols get their own chunk. each symbol is charged to a memory
+ * category (see lib/memory.c) as it's handed out, the chunks themselves
+ * aren't charged to anything.
+ */
+
+#define ARENA_CHUNK 32768
+#define ARENA_ALIGN 16                    /* alignment of every symbol */
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+static char *Arena;                       /* next free byte in the current chunk */
+static char *Arena_end;                   /* end of the current chunk */
+static long Charged[MEM_MAXCAT];          /* what's been charged to each category */
+
+static void *nomem(void)
+{
+  fprintf(stderr, "can't get memory\n");
+  exit(1);
+  return NULL;
+}
 
 void *newsym(unsigned int size) 
 {
-  BUCKET *sym = (BUCKET *)calloc(1, size + sizeof(BUCKET));
+  return newsym_in(MEM_SYMBOLS, size);
+}
+
+void *newsym_in(int cat, unsigned int size) 
+{
+  /* like newsym(), but the memory is charged to cat */
+
+  BUCKET *sym;
   
-  if (!sym) {
-    fprintf(stderr, "can't get memory\n");
-    exit(1);
-    return NULL;
+  size = ARENA_ROUND(ARENA_ROUND(sizeof(BUCKET)) + size);
+
+  if (size > ARENA_CHUNK / 4) {
+    if (!(sym = (BUCKET *) mem_calloc(MEM_NONE, 1, size))) {
+      return nomem();
+    }
+  } else {
+    if (Arena + size > Arena_end) {
+      if (!(Arena = (char *) mem_calloc(MEM_NONE, 1, ARENA_CHUNK))) {
+        return nomem();
+      }
+      Arena_end = Arena + ARENA_CHUNK;
+    }
+    sym = (BUCKET *) Arena;
+    Arena += size;
   }
 
-  return (void *)(sym + 1);
+  mem_charge(cat, size);
+  Charged[cat >= 0 && cat < MEM_MAXCAT ? cat : MEM_OTHER] += size;
+  return (void *) ((char *) sym + ARENA_ROUND(sizeof(BUCKET)));
 }
 
 void freesym(void *sym) 
 {
-  free((BUCKET *)sym -1);
+  /* symbols live in the arena, see newsym() */
 }
 
+void newsym_reset()
+{
+  /* start on a new chunk, and give back what the symbols were charged. a
+   * program that frees all of its symbols with mem_release() has to call
+   * this, the current chunk is gone.
+   */
+
+  int cat;
+
+  for (cat = 0; cat < MEM_MAXCAT; ++cat) {
+    mem_charge(cat, -Charged[cat]);
+    Charged[cat] = 0;
+  }
+  Arena = Arena_end = NULL;
+}
+
+#define TO_BUCKET(sym) ((BUCKET *) ((char *) (sym) - ARENA_ROUND(sizeof(BUCKET))))
+#define TO_SYM(bkt)    ((void *) ((char *) (bkt) + ARENA_ROUND(sizeof(BUCKET))))
+
+static int first_slot(HASH_TAB *tabp, unsigned int hval)
+{
+  /* fibonacci hashing: the multiply spreads weak hash values over the table */
+
+  return (unsigned int) (hval * 2654435769u) >> tabp->shift;
+}
+
+static void newslots(HASH_TAB *tabp, int size)
+{
+  /* give tabp an empty array of size slots and put all the symbols back
+   * into it, in insertion order. the cached hash values are used, the hash
+   * function isn't called.
+   */
+
+  HASH_SLOT *slot;
+  BUCKET *sym;
+  int i, bits;
+
+  for (bits = 0; (1 << bits) < size; ++bits) {
+    ;
+  }
+
+  mem_free(tabp->table);
+  if (!(tabp->table = (HASH_SLOT *) mem_calloc(MEM_HASH, size, sizeof(HASH_SLOT)))) {
+    nomem();
+  }
+
+  tabp->size  = size;
+  tabp->shift = 32 - bits;
+  tabp->used  = tabp->numsyms;
+
+  for (sym = tabp->first; sym; sym = sym->next) {
+    for (i = first_slot(tabp, sym->hval); tabp->table[i].sym; i = (i + 1) & (size - 1)) {
+      ;
+    }
+    slot = &tabp->table[i];
+    slot->hval = sym->hval;
+    slot->sym = sym;
+  }
+}
 
 HASH_TAB *maketab(unsigned int maxsym, unsigned int (*hash)(), int (*cmp)()) 
 {
+  /* make a table that holds about maxsym symbols before it has to grow */
+
+  HASH_TAB *p;
+  int size;
+
   if (!maxsym) {
     maxsym = 127;
   }
 
-  HASH_TAB *p = (HASH_TAB *) calloc (1, maxsym * sizeof(BUCKET *) + sizeof(HASH_TAB));
-  if (!p) {
-    fprintf(stderr, "can't get memory\n");
-    exit(1);
+  for (size = 16; MAXLOAD(size) < maxsym; size <<= 1) {
+    ;
+  }
+
+  if (!(p = (HASH_TAB *) mem_calloc(MEM_HASH, 1, sizeof(HASH_TAB)))) {
+    nomem();
   }
-  p->size = maxsym;
   p->numsyms = 0;
   p->hash = (unsigned int (*)(void *))hash;
   p->cmp = (int (*)(void*, void*))cmp;
+  p->first = NULL;
+  p->last = &p->first;
+  newslots(p, size);
 
   return p;
 }
@@ -45,109 +165,170 @@ HASH_TAB *maketab(unsigned int maxsym, unsigned int (*hash)(), int (*cmp)())
 
 void *addsym(HASH_TAB *tabp, void *isym)
 {
-  BUCKET *sym = (BUCKET *)isym;
-  BUCKET **p = &(tabp->table)[tabp->hash(sym--) % tabp->size];
-  
-  BUCKET *tmp = *p;
-  *p = sym;
-  sym->prev = p;
-  sym->next = tmp;
+  BUCKET *sym = TO_BUCKET(isym);
+  HASH_SLOT *slot;
+  int i, mask;
 
-  if (tmp) {
-    tmp->prev = &sym->next;
+  if (tabp->used + 1 > MAXLOAD(tabp->size)) {
+    /* double the table if it's really full, otherwise just sweep the tombstones out */
+    newslots(tabp, (tabp->numsyms + 1) > MAXLOAD(tabp->size) / 2 ? tabp->size * 2 : tabp->size);
   }
 
+  sym->hval = tabp->hash(isym);
+  mask = tabp->size - 1;
+
+  for (i = first_slot(tabp, sym->hval); ; i = (i + 1) & mask) {
+    slot = &tabp->table[i];
+    if (!slot->sym) {
+      ++tabp->used;
+      break;
+    }
+    if (slot->sym == HASH_TOMBSTONE) {
+      break;
+    }
+  }
+
+  slot->hval = sym->hval;
+  slot->sym = sym;
+
+  sym->next = NULL;           /* link to the end of the insertion-order list */
+  sym->prev = tabp->last;
+  *tabp->last = sym;
+  tabp->last = &sym->next;
+
   tabp->numsyms++;
-  return (void *)(sym + 1);
+  return isym;
 }
 
 void delsym (HASH_TAB *tabp, void *isym)
 {
+  BUCKET *sym;
+  int i, mask;
+
   if (tabp && isym) {
-    BUCKET *sym = (BUCKET *)isym - 1;
-    --tabp->numsyms;
+    sym = TO_BUCKET(isym);
+    mask = tabp->size - 1;
+
+    for (i = first_slot(tabp, sym->hval); tabp->table[i].sym; i = (i + 1) & mask) {
+      if (tabp->table[i].sym == sym) {
+        tabp->table[i].sym = HASH_TOMBSTONE;
+        break;
+      }
+    }
 
     if (*(sym->prev) = sym->next) {
       sym->next->prev = sym->prev;
+    } else {
+      tabp->last = sym->prev;
     }
+
+    --tabp->numsyms;
   }
 }
 
+static void *probe(HASH_TAB *tabp, void *sym, unsigned int hval, int i)
+{
+  /* look for a symbol that matches sym, starting at slot i */
+
+  HASH_SLOT *slot;
+  int mask = tabp->size - 1;
+  int n = 0;            /* # of occupied slots examined */
+  void *found = NULL;
+
+  for (; (slot = &tabp->table[i])->sym; i = (i + 1) & mask) {
+    ++n;
+    if (slot->sym != HASH_TOMBSTONE && slot->hval == hval) {
+      ++tabp->compares;
+      if ((tabp->cmp)(sym, TO_SYM(slot->sym)) == 0) {
+        found = TO_SYM(slot->sym);
+        break;
+      }
+    }
+  }
+
+  ++tabp->lookups;
+  tabp->probes += n;
+  ++tabp->hist[n < HASH_HIST ? n : HASH_HIST - 1];
+  return found;
+}
+
 void *findsym(HASH_TAB *tabp, void *sym) {
+  unsigned int hval;
+
   if (!tabp) {
     return NULL;
   }
   
-  BUCKET *p = (tabp->table)[ tabp->hash(sym) % tabp->size];
-
-  while (p && (tabp->cmp)(sym, p + 1)) {
-    p = p->next;
-  }
-
-  return (void *) p ? p + 1 : NULL; 
+  hval = tabp->hash(sym);
+  return probe(tabp, sym, hval, first_slot(tabp, hval));
 }
 
 void *nextsym(HASH_TAB *tabp, void *i_last)
 {
-  BUCKET *last = (BUCKET *)i_last;
-  for (--last; last->next; last = last->next) {
-    if (tabp->cmp(i_last, last->next + 1) == 0) {
-      return (void *) (last->next + 1);
+  /* return the next symbol with the same key as i_last (which must be in the table) */
+
+  BUCKET *last = TO_BUCKET(i_last);
+  int i, mask = tabp->size - 1;
+
+  for (i = first_slot(tabp, last->hval); tabp->table[i].sym != last; i = (i + 1) & mask) {
+    if (!tabp->table[i].sym) {
+      return NULL;
     }
   }
-  return NULL;
+
+  return probe(tabp, i_last, last->hval, (i + 1) & mask);
 }
 
 int (*user_cmp)(void *, void *);
 
 int internal_cmp(const void *p1, const void *p2)
 {
-  return (user_cmp)((void*)(*(BUCKET **)p1 + 1), (void*)(*(BUCKET **)p2 + 1));
+  return (user_cmp)(TO_SYM(*(BUCKET **)p1), TO_SYM(*(BUCKET **)p2));
 }
 
 int ptab(HASH_TAB *tabp, ptab_t print, void *param, int sort) 
 {
-  BUCKET **symtab;
+  /* call print() for every symbol in the table, in insertion order or, if
+   * sort is true, in the order given by the comparison function. print()
+   * may delete symbols (other than the one that it's given) from the table.
+   */
+
   BUCKET **outtab;
+  BUCKET **outp;
   BUCKET *sym;
   int i;
 
-  if (!tabp || tabp->size == 0) {
+  if (!tabp || tabp->numsyms == 0) {
     return 1;
   }
 
   if (!sort) {  
-    for (symtab = tabp->table, i = tabp->size; --i >= 0; symtab++) {
-      for (sym = *symtab; sym; sym = sym->next) {
-        print(sym + 1, param);
-      }
+    for (sym = tabp->first; sym; sym = sym->next) {
+      print(TO_SYM(sym), param);
     }
   } else {
-    outtab = (BUCKET **) malloc (tabp->numsyms * sizeof (BUCKET *));
+    outtab = (BUCKET **) mem_alloc(MEM_HASH, tabp->numsyms * sizeof (BUCKET *));
     if (!outtab) {
       fprintf(stderr, "can't get memory\n");
       return 0;
     }
 
-    BUCKET **outp = outtab;
-    for (symtab = tabp->table, i = tabp->size; --i >= 0; symtab++) {
-      for (sym = *symtab; sym; sym = sym->next) {
-        if (outp >= outtab + tabp->numsyms) {
-          fprintf(stderr, "internal error\n");
-          exit(1);
-        }
-        *outp++ = sym;
+    for (outp = outtab, sym = tabp->first; sym; sym = sym->next) {
+      if (outp >= outtab + tabp->numsyms) {
+        fprintf(stderr, "internal error\n");
+        exit(1);
       }
+      *outp++ = sym;
     }
 
     user_cmp = tabp->cmp;
     qsort(outtab, tabp->numsyms, sizeof(BUCKET *), internal_cmp);
 
     for (outp = outtab, i = tabp->numsyms; --i >= 0; outp++) {
-      print(*(outp) + 1, param);
+      print(TO_SYM(*outp), param);
     }
 
-    free(outtab);
+    mem_free(outtab);
   }
 
   return 1;
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <compiler.h>
+
+/*
+ * memory.c: malloc() and friends, with every allocation charged to a
+ * category so that a program can find out where its memory goes. each block
+ * is preceded by a header that holds its size and category, so mem_free()
+ * and mem_realloc() take back exactly what was charged. memory that's carved
+ * out of a larger block (newsym()'s arena, for example) can be charged with
+ * mem_charge() instead.
+ *
+ * the library uses the categories below MEM_USER (sets, hash tables and
+ * symbols), the program names the rest with mem_name(). the counts are
+ * updated atomically because the allocators are called from several threads.
+ *
+ * between mem_track(1) and mem_release(), every block that's allocated is
+ * also put on a list, and mem_release() frees the ones that are still on it,
+ * so that a program can run a job that doesn't free its memory more than
+ * once (see librbison.c). the list is locked with a spin lock: it's only used
+ * while tracking, and the blocks are rarely freed one at a time.
+ */
+
+typedef struct _mem_hdr_ {
+  size_t size;                /* bytes asked for */
+  int cat;                    /* category they're charged to */
+  int tracked;                /* it's on the Tracked list */
+  struct _mem_hdr_ *prev;     /* the list, if it's on it */
+  struct _mem_hdr_ *next;
+} MEM_HDR;
+
+#define HDR_SIZE ((sizeof(MEM_HDR) + 15) & ~15)   /* keeps malloc()'s alignment */
+
+typedef struct _mem_cat_ {
+  char *name;
+  long cur;                   /* bytes in use */
+  long peak;                  /* most bytes in use at once */
+  long nallocs;               /* # of allocations */
+} MEM_CAT;
+
+static MEM_CAT Cats[MEM_MAXCAT] = {
+  { "other" }, { "sets" }, { "hash tables" }, { "symbols" },
+};
+
+static MEM_CAT Total;         /* all categories together */
+static long Mark_peak;        /* most bytes in use since mem_mark() */
+
+static int Tracking = 0;      /* set by mem_track() */
+static MEM_HDR Tracked = { 0, 0, 0, &Tracked, &Tracked };   /* the list's head */
+static char Track_lock = 0;
+
+static void track(MEM_HDR *hdr)
+{
+  while (__atomic_test_and_set(&Track_lock, __ATOMIC_ACQUIRE)) {
+    ;
+  }
+  hdr->tracked = 1;
+  hdr->next = Tracked.next;
+  hdr->prev = &Tracked;
+  Tracked.next->prev = hdr;
+  Tracked.next = hdr;
+  __atomic_clear(&Track_lock, __ATOMIC_RELEASE);
+}
+
+static void untrack(MEM_HDR *hdr)
+{
+  while (__atomic_test_and_set(&Track_lock, __ATOMIC_ACQUIRE)) {
+    ;
+  }
+  hdr->prev->next = hdr->next;
+  hdr->next->prev = hdr->prev;
+  hdr->tracked = 0;
+  __atomic_clear(&Track_lock, __ATOMIC_RELEASE);
+}
+
+static void raise_peak(long *peak, long cur)
+{
+  long old = __atomic_load_n(peak, __ATOMIC_RELAXED);
+
+  while (cur > old && !__atomic_compare_exchange_n(peak, &old, cur, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    ;
+  }
+}
+
+void mem_charge(int cat, long bytes)
+{
+  /* charge bytes to cat. negative bytes give memory back. every positive
+   * charge (a realloc() that grows a block, too) counts as an allocation.
+   */
+
+  MEM_CAT *c = &Cats[cat >= 0 && cat < MEM_MAXCAT ? cat : MEM_OTHER];
+  long cur;
+
+  if (cat == MEM_NONE) {
+    return;
+  }
+
+  if (bytes > 0) {
+    __atomic_add_fetch(&c->nallocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&Total.nallocs, 1, __ATOMIC_RELAXED);
+  }
+
+  raise_peak(&c->peak, __atomic_add_fetch(&c->cur, bytes, __ATOMIC_RELAXED));
+  cur = __atomic_add_fetch(&Total.cur, bytes, __ATOMIC_RELAXED);
+  raise_peak(&Total.peak, cur);
+  raise_peak(&Mark_peak, cur);
+}
+
+void *mem_alloc(int cat, size_t size)
+{
+  /* works like malloc(), returns NULL if there's no memory */
+
+  MEM_HDR *hdr;
+
+  if (!(hdr = (MEM_HDR *) malloc(HDR_SIZE + size))) {
+    return NULL;
+  }
+  hdr->size = size;
+  hdr->cat = cat;
+  hdr->tracked = 0;
+  if (Tracking) {
+    track(hdr);
+  }
+  mem_charge(cat, size);
+  return (char *) hdr + HDR_SIZE;
+}
+
+void *mem_calloc(int cat, size_t n, size_t size)
+{
+  void *p;
+
+  if ((p = mem_alloc(cat, n * size))) {
+    memset(p, 0, n * size);
+  }
+  return p;
+}
+
+void *mem_realloc(int cat, void *p, size_t size)
+{
+  /* works like realloc(). the block stays in the category that it was
+   * allocated in, cat is only used if p is NULL.
+   */
+
+  MEM_HDR *hdr, *new;
+  size_t old;
+  int tracked;
+
+  if (!p) {
+    return mem_alloc(cat, size);
+  }
+
+  hdr = (MEM_HDR *) ((char *) p - HDR_SIZE);
+  old = hdr->size;
+  if ((tracked = hdr->tracked)) {   /* the block may move */
+    untrack(hdr);
+  }
+  if (!(new = (MEM_HDR *) realloc(hdr, HDR_SIZE + size))) {
+    if (tracked) {
+      track(hdr);
+    }
+    return NULL;
+  }
+  hdr = new;
+  if (tracked) {
+    track(hdr);
+  }
+  hdr->size = size;
+  mem_charge(hdr->cat, (long) size - (long) old);
+  return (char *) hdr + HDR_SIZE;
+}
+
+char *mem_strdup(int cat, char *str)
+{
+  char *p;
+
+  if ((p = (char *) mem_alloc(cat, strlen(str) + 1))) {
+    strcpy(p, str);
+  }
+  return p;
+}
+
+void mem_free(void *p)
+{
+  MEM_HDR *hdr;
+
+  if (p) {
+    hdr = (MEM_HDR *) ((char *) p - HDR_SIZE);
+    if (hdr->tracked) {
+      untrack(hdr);
+    }
+    mem_charge(hdr->cat, -(long) hdr->size);
+    free(hdr);
+  }
+}
+
+void mem_track(int on)
+{
+  /* start (on != 0) or stop putting new blocks on the list that
+   * mem_release() frees. the blocks that are on it stay there.
+   */
+
+  Tracking = on;
+}
+
+void mem_release()
+{
+  /* free every block on the list, and stop tracking. nothing else may
+   * allocate or free memory while this runs.
+   */
+
+  MEM_HDR *hdr;
+
+  Tracking = 0;
+  while ((hdr = Tracked.next) != &Tracked) {
+    untrack(hdr);
+    mem_charge(hdr->cat, -(long) hdr->size);
+    free(hdr);
+  }
+}
+
+void mem_name(int cat, char *name)
+{
+  /* name a category. name must be a string constant */
+
+  if (cat >= 0 && cat < MEM_MAXCAT) {
+    Cats[cat].name = name;
+  }
+}
+
+int mem_stats(int cat, char **name, long *cur, long *peak, long *nallocs)
+{
+  /* get the counts for cat, or for all categories together if cat is
+   * MEM_TOTAL. return 0 if cat has never been named or used.
+   */
+
+  MEM_CAT *c;
+
+  if (cat == MEM_TOTAL) {
+    c = &Total;
+  } else if (cat < 0 || cat >= MEM_MAXCAT || (!(c = &Cats[cat])->name && !c->nallocs)) {
+    return 0;
+  }
+
+  *name    = c->name ? c->name : "unnamed";
+  *cur     = c->cur;
+  *peak    = c->peak;
+  *nallocs = c->nallocs;
+  return 1;
+}
+
+long mem_mark()
+{
+  /* start watching for a new peak, see mem_mark_peak(). return the number
+   * of bytes in use.
+   */
+
+  long cur = __atomic_load_n(&Total.cur, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&Mark_peak, cur, __ATOMIC_RELAXED);
+  return cur;
+}
+
+long mem_mark_peak()
+{
+  /* return the most bytes that were in use since the last mem_mark() */
+
+  return __atomic_load_n(&Mark_peak, __ATOMIC_RELAXED);
+}
@@ -2,11 +2,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <set.h>
+#include <hash.h>
 #include <compiler.h>
 
+/* interned sets, see intern() */
+static HASH_TAB *Interned = NULL;
+static long Intern_lookups = 0;   /* # of intern() calls that searched the table */
+static long Intern_hits = 0;      /* # of those that found an existing set */
+static long Intern_bytes = 0;     /* memory used by the canonical sets */
+
 SET *newset() 
 {
-  SET *p = (SET *) malloc (sizeof(SET));
+  SET *p = (SET *) mem_alloc(MEM_SETS, sizeof(SET));
   if (!p) {
     fprintf(stderr, "can't get memory\n");
     exit(1);
@@ -20,12 +27,27 @@ SET *newset()
   return p;
 }
 
+void initset(SET *set, unsigned int *map, int nsize)
+{
+  /* make an empty set in memory supplied by the caller: set is the SET
+   * itself and map holds nsize cells. the set never frees map. if it has
+   * to grow, the bits are copied to a map of its own.
+   */
+
+  memset(set, 0, sizeof(SET));
+  memset(map, 0, nsize * sizeof(unsigned int));
+  set->map = map;
+  set->nsize = nsize;
+  set->nbits = nsize * _BITS_IN_INT;
+  set->borrowed = 1;
+}
+
 void delset(SET *set) 
 {
-  if (set->map != set->defmap) {
-    free(set->map);
+  if (set->map != set->defmap && !set->borrowed) {
+    mem_free(set->map);
   }
-  free(set);
+  mem_free(set);
 }
 
 SET *dupset(SET *set) 
@@ -34,7 +56,7 @@ SET *dupset(SET *set)
     return NULL;
   }
 
-  SET *new_set = (SET *) malloc (sizeof(SET));
+  SET *new_set = (SET *) mem_alloc(MEM_SETS, sizeof(SET));
   if (!new_set) {
     fprintf(stderr, "can't get memory\n");
     exit(1);
@@ -50,7 +72,7 @@ SET *dupset(SET *set)
     new_set->map = new_set->defmap;
     memcpy(new_set->defmap, set->defmap, _DEFSIZE * sizeof(unsigned int));
   } else {
-    new_set->map = (unsigned int *) malloc (new_set->nsize * sizeof(unsigned int));
+    new_set->map = (unsigned int *) mem_alloc(MEM_SETS, new_set->nsize * sizeof(unsigned int));
     if (!new_set->map) {
       fprintf(stderr, "can't get memory\n");
       exit(1);
@@ -68,7 +90,7 @@ void enlarge(int need, SET *set) {
     return;
   }
 
-  unsigned int *new_map = (unsigned int *) malloc (need * sizeof (unsigned int));
+  unsigned int *new_map = (unsigned int *) mem_alloc(MEM_SETS, need * sizeof (unsigned int));
   if (!new_map) {
     fprintf(stderr, "can't get memory\n");
     exit(1);
@@ -77,9 +99,10 @@ void enlarge(int need, SET *set) {
   memcpy(new_map, set->map, set->nsize * sizeof(unsigned int));
   memset(new_map + set->nsize, 0, (need - set->nsize) * sizeof (unsigned int));
 
-  if (set->map != set->defmap) {
-    free(set->map);
+  if (set->map != set->defmap && !set->borrowed) {
+    mem_free(set->map);
   }
+  set->borrowed = 0;
   set->map = new_map;
   set->nsize = (unsigned int) need;
   set->nbits = set->nsize * _BITS_IN_INT;
@@ -171,19 +194,100 @@ int setcmp(SET *set1, SET *set2)
   return 0;
 }
 
+static int used_cells(SET *set)
+{
+  /* return the number of cells up to and including the last nonzero one */
+
+  int i = set->nsize;
+
+  while (i > 0 && !set->map[i - 1]) {
+    --i;
+  }
+  return i;
+}
+
 unsigned int sethash(SET *set) {
-  unsigned int total = 0;
+  /* trailing zero cells are skipped, so sets that setcmp() considers equal
+   * hash alike even if their maps are different sizes.
+   */
+
+  unsigned int h = 2166136261u;   /* FNV-1a, a cell at a time */
   int i;
-  for (i = 0; i < set->nsize; i++) {
-    total += set->map[i];
+
+  for (i = used_cells(set); --i >= 0; ) {
+    h = (h ^ set->map[i]) * 16777619u;
+  }
+  return h;
+}
+
+static int intern_cmp(SET *set1, SET *set2)
+{
+  return set1->compl != set2->compl || setcmp(set1, set2);
+}
+
+SET *intern(SET *set)
+{
+  /* return the canonical copy of set: all sets with the same members share
+   * one copy, so interned sets can be compared by pointer. the copy is
+   * immutable. to change it, copy it into a scratch set, change that and
+   * intern the result. set itself isn't modified.
+   */
+
+  SET *canon;
+  int n;
+
+  if (set->interned) {
+    return set;
+  }
+
+  if (!Interned) {
+    Interned = maketab(0, sethash, intern_cmp);
+  }
+
+  ++Intern_lookups;
+  if ((canon = (SET *) findsym(Interned, set))) {
+    ++Intern_hits;
+    return canon;
   }
-  return total;
+
+  n = max(1, used_cells(set));    /* the canonical map is trimmed */
+  canon = (SET *) newsym_in(MEM_SETS, sizeof(SET) + n * sizeof(unsigned int));
+  initset(canon, (unsigned int *) (canon + 1), n);
+  memcpy(canon->map, set->map, n * sizeof(unsigned int));
+  canon->compl = set->compl;
+  canon->interned = 1;
+  Intern_bytes += sizeof(SET) + n * sizeof(unsigned int);
+
+  return (SET *) addsym(Interned, canon);
+}
+
+void intern_reset()
+{
+  /* forget the interned sets, for a program that's freed them with
+   * mem_release()
+   */
+
+  Interned = NULL;
+  Intern_lookups = Intern_hits = Intern_bytes = 0;
+}
+
+void intern_stats(long *lookups, long *hits, int *nsets, long *bytes)
+{
+  *lookups = Intern_lookups;
+  *hits    = Intern_hits;
+  *nsets   = Interned ? Interned->numsyms : 0;
+  *bytes   = Intern_bytes;
 }
 
 int subset(SET *set, SET *possible_subset) 
 {
   int common;
   int tail;
+
+  if (set == possible_subset) {
+    return 1;
+  }
+
   if (possible_subset->nsize > set->nsize) {
     common = set->nsize;
     tail = possible_subset->nsize - common;
@@ -265,8 +369,11 @@ void invert(SET *set)
 
 void truncate(SET *set) {
   if (set->map != set->defmap) {
-    free(set->map);
+    if (!set->borrowed) {
+      mem_free(set->map);
+    }
     set->map = set->defmap;
+    set->borrowed = 0;
   }
   set->nsize = _DEFSIZE;
   set->nbits = _DEFBITS;
@@ -300,6 +407,28 @@ int next_member(SET *set)
   return -1;
 }
 
+int next_after(SET *set, int prev)
+{
+  /* return the smallest member of set that's larger than prev (pass -1 to
+   * get the first one), or -1 if there isn't one. unlike next_member() it
+   * keeps no state, so several threads can use it at once.
+   */
+
+  int bit = prev + 1;
+
+  while (bit < set->nbits) {
+    if (!set->compl && !(bit & (_BITS_IN_INT - 1)) && !set->map[_DIV_INDEX(bit)]) {
+      bit += _BITS_IN_INT;  /* skip an empty cell */
+    } else if (TEST(set, bit)) {
+      return bit;
+    } else {
+      ++bit;
+    }
+  }
+
+  return -1;
+}
+
 void pset(SET *set, pset_t output_routine, void *param) {
   if (!set) {
     (*output_routine)(param, "null\n", -1);
@@ -7,11 +7,6 @@
 #include <ctype.h>
 
 
-#include <stack.h>  /* stack-manipulation macros */
-#include <string.h>
-#undef  stack_cls   /* make all stacks static */
-#define stack_cls static
-
 #include "parser.h"
 #include "llout.h"
 
@@ -41,6 +36,14 @@ typedef struct _cur_sym_
 static CUR_SYM cur_sym;
 static CUR_SYM *p_cur_sym = &cur_sym;
 
+static int Nvals = 0;             /* # of elements allocated for Terms[] and Precedence[] */
+
+static SYMBOL **Early = NULL;     /* nonterminals created by %type, before Min_nonterm */
+static int Nearly = 0;            /* is known. first_sym() gives them their values */
+static int Max_early = 0;
+
+#define RHS_CHUNK 8               /* PRODUCTION.rhs grows by this many elements */
+
 /* support routines for actions */
 
 
@@ -108,8 +111,8 @@ char *production_str(PRODUCTION *prod)
   if (!prod->rhs_len) {
     sprintf(p, " (epsilon)");
   } else {
-    for (i = 0; i < prod->rhs_len && avail > 0; i++) {
-      nchars = sprintf(p, " %0.*s", avail - 1, prod->rhs[i]->name);
+    for (i = 0; i < prod->rhs_len && avail > 2; i++) {  /* room for ' ', a char and '\0' */
+      nchars = sprintf(p, " %0.*s", avail - 2, prod->rhs[i]->name);
       avail -= nchars;
       p += nchars;
     }
@@ -118,12 +121,36 @@ char *production_str(PRODUCTION *prod)
 }
 
 
-void pnonterm(SYMBOL *sym, FILE *stream)
+static void pprods(PRODUCTION *p, FILE *stream)
 {
-  PRODUCTION *p;
+  /* productions are put into the SYMBOL in reverse order because it's easier
+   * to tack them on to the beginning of the linked list. it's better to print
+   * them in forward order, however, to make the symbol table more readable.
+   * solve this problem by printing the rest of the list before printing p.
+   */
+
   int chars_printed;
-  stack_dcl(pstack, PRODUCTION *, MAXPROD);
-  
+
+  if (!p) {
+    return;
+  }
+
+  pprods(p->next, stream);
+
+  chars_printed = fprintf(stream, "   %3d: %s", p->num, production_str(p));
+
+  if (p->prec) {
+    for ( ; chars_printed <= 60; ++chars_printed) {
+      putc('.', stream);
+    }
+
+    fprintf(stream, "PREC %d", p->prec);
+  }
+  putc('\n', stream);
+}
+
+void pnonterm(SYMBOL *sym, FILE *stream)
+{
   if (!ISNONTERM(sym)) {
     return;
   }
@@ -140,32 +167,7 @@ void pnonterm(SYMBOL *sym, FILE *stream)
     fprintf(stream, "\n");
   }
 
-  /* productions are put into the SYMBOL in reverse order because it's easier
-   * to tack them on to the beginning of the linked list. it's better to print
-   * them in forward order, however, to make the symbol table more readable.
-   * solve this problem by stacking all the productions and then popping
-   * elements to print them. since the pstack has MAXPROD elements, it's not
-   * necessary to test for stack overflow on a push
-   */
-  
-  for (p = sym->productions; p; p = p->next) {
-    push(pstack, p);
-  }
-
-  while (!stack_empty(pstack)) {
-    p = pop(pstack);
-    chars_printed = fprintf(stream, "   %3d: %s", p->num, production_str(p));
-
-    if (p->prec) {
-      for ( ; chars_printed <= 60; ++chars_printed) {
-        putc('.', stream);
-      }
-
-      fprintf(stream, "PREC %d", p->prec);
-    }
-    putc('\n', stream);
-  }
-
+  pprods(sym->productions, stream);
   fprintf(stream, "\n");
 }
 
@@ -222,16 +224,65 @@ void init_acts()
    * routine before starting up the parser. the hash-table size (157) is
    * an arbitrary prime number, roughly the number symbols expected in the
    * table. note that using hash_pjw knocks about 25% off the execution
-   * time as compared to hash_add
+   * time as compared to hash_add. librbison.c makes more than one grammar
+   * in a run, so everything that the acts change starts over here.
    */
    
   static SYMBOL bogus_symbol;
+
+  Terms = NULL;
+  Precedence = NULL;
+  Nvals = 0;
+  Early = NULL;
+  Nearly = Max_early = 0;
+  Goal_symbol = NULL;
+  Goal_symbol_is_next = 0;
+  Associativity = Prec_lev = Fields_active = 0;
+  memset(&cur_sym, 0, sizeof(cur_sym));
+  Cur_term = MINTERM - 1;
+  Min_nonterm = 0;
+  Cur_nonterm = Cur_act = -1;
+  Num_productions = 0;
+
+  memset(&bogus_symbol, 0, sizeof(bogus_symbol));
   strcpy(bogus_symbol.name, "end of input");
-  Terms[0] = &bogus_symbol;
+  set_val(&bogus_symbol, 0);
   
   Symtab = maketab(157, hash_pjw, strcmp);
 }
 
+static void grow_vals(int val)
+{
+  /* make sure that Terms[val] and Precedence[val] exist. new elements are zeroed */
+
+  int n = Nvals;
+
+  if (val >= Nvals) {
+    while (val >= n) {
+      n = n ? n * 2 : 256;
+    }
+
+    Terms = (SYMBOL **) mem_realloc(MEM_SYMBOLS, Terms, n * sizeof(SYMBOL *));
+    Precedence = (PREC_TAB *) mem_realloc(MEM_SYMBOLS, Precedence, n * sizeof(PREC_TAB));
+    if (!Terms || !Precedence) {
+      error(FATAL, "no memory for symbol values\n");
+    }
+
+    memset(Terms + Nvals, 0, (n - Nvals) * sizeof(SYMBOL *));
+    memset(Precedence + Nvals, 0, (n - Nvals) * sizeof(PREC_TAB));
+    Nvals = n;
+  }
+}
+
+void set_val(SYMBOL *sym, int val)
+{
+  /* give sym the numeric value val and make Terms[val] point at it */
+
+  grow_vals(val);
+  sym->val = val;
+  Terms[val] = sym;
+}
+
 static int c_identifier(char *name) /* return true only if name is a legitimate C identifier */
 {
   if (isdigit(*name)) {
@@ -257,16 +308,16 @@ SYMBOL *make_term(char *name)   /* make a terminal symbol */
   } else if (p = (SYMBOL *) findsym(Symtab, name)) {
     lerror(WARNING, "terminal symbol <%s> already declared\n", name);
   } else {
-    if (Cur_term >= MAXTERM) {
-      lerror(FATAL, "too many terminal symbols (%d max)\n", MAXTERM);
+    if (Min_nonterm) {
+      lerror(FATAL, "terminal symbol <%s> declared after the %%%%\n", name);
     }
     p = (SYMBOL *) newsym(sizeof(SYMBOL));
     strncpy(p->name, name, NAME_MAX);
     strncpy(p->field, Field_name, NAME_MAX);
     addsym(Symtab, p);
-    p->val = ++Cur_term;
+    p->kind = SYM_TERM;
     p->set = yylineno;
-    Terms[Cur_term] = p;
+    set_val(p, ++Cur_term);
   }
 
   return p;
@@ -275,10 +326,28 @@ SYMBOL *make_term(char *name)   /* make a terminal symbol */
 void first_sym()
 {
   /* this routine is called just before the first rule following the %%
-   * it's used to point out the goal symbol
+   * it's used to point out the goal symbol. all the terminals have been
+   * declared by now, so the nonterminal values can be fixed too. they
+   * start just past EPSILON, or past WHITESPACE if that's bigger (it's
+   * used as a lookahead, see make_parse_tables()). the nonterminals that
+   * were created by %type are numbered first, in order of appearance.
    */
   
+  int i;
+
   Goal_symbol_is_next = 1;
+
+  Min_nonterm = max(EPSILON, WHITESPACE) + 1;
+  Cur_nonterm = Min_nonterm - 1;
+  grow_vals(Min_nonterm - 1);  /* Terms[WHITESPACE] and Precedence[WHITESPACE] must exist */
+
+  for (i = 0; i < Nearly; ++i) {
+    set_val(Early[i], ++Cur_nonterm);
+  }
+
+  mem_free(Early);
+  Early = NULL;
+  Nearly = Max_early = 0;
 }
 
 SYMBOL *new_nonterm(char *name, int is_lhs)
@@ -298,15 +367,24 @@ SYMBOL *new_nonterm(char *name, int is_lhs)
       lerror(NONFATAL, "symbol on left-hand side must be nonterminal\n");
       p = NULL;
     }
-  } else if (Cur_nonterm >= MAXNONTERM) {
-    lerror(FATAL, "too many nonterminal symbols (%d max)\n", MAXNONTERM);
   } else { /* add new nonterminal to symbol table */
     p = (SYMBOL *) newsym(sizeof(SYMBOL));
     strncpy(p->name, name, NAME_MAX);
     strncpy(p->field, Field_name, NAME_MAX);
-    p->val = ++Cur_nonterm;
-    Terms[Cur_nonterm] = p;
+    p->kind = SYM_NONTERM;
     addsym(Symtab, p);
+
+    if (Min_nonterm) {
+      set_val(p, ++Cur_nonterm);
+    } else {  /* declared by %type, first_sym() will number it */
+      if (Nearly >= Max_early) {
+        Max_early = Max_early ? Max_early * 2 : 16;
+        if (!(Early = (SYMBOL **) mem_realloc(MEM_SYMBOLS, Early, Max_early * sizeof(SYMBOL *)))) {
+          lerror(FATAL, "no memory for nonterminal\n");
+        }
+      }
+      Early[Nearly++] = p;
+    }
   }
 
   if (p) { /* (re)initialize new nonterminal */
@@ -341,17 +419,16 @@ void new_rhs()
    * to 0 when it's declared.
    */
   PRODUCTION *p;
-  if (!(p = (PRODUCTION *) calloc(1, sizeof(PRODUCTION)))) {
+  if (!(p = (PRODUCTION *) mem_calloc(MEM_PRODS, 1, sizeof(PRODUCTION)))
+        || !(p->rhs = (SYMBOL **) mem_calloc(MEM_PRODS, RHS_CHUNK, sizeof(SYMBOL *)))) {
     lerror(FATAL, "no memory for new right-hand side\n");
   }
 
+  p->rhs_max = RHS_CHUNK;
   p->next = p_cur_sym->lhs->productions;
   p_cur_sym->lhs->productions = p;
 
-  if ((p->num = Num_productions++) >= MAXPROD) {
-    lerror(FATAL, "too many productions (%d max)\n", MAXPROD);
-  }
-
+  p->num = Num_productions++;
   p->lhs = p_cur_sym->lhs;
   p_cur_sym->rhs = p;
 }
@@ -364,7 +441,7 @@ void new_rhs()
 void add_to_rhs(char *object, int is_an_action) 
 {
   SYMBOL *p;
-  int i;
+  PRODUCTION *prod = p_cur_sym->rhs;
   char buf[32];
 
   /* add a new element to the RHS currently nonterminal symbol. first deal with
@@ -388,34 +465,39 @@ void add_to_rhs(char *object, int is_an_action)
        * is used to allocate memory for the new node (ie. that it's
        * initialized to zeros).
        */
-      sprintf(buf, "{%d}", ++Cur_act - MINACT);
+      sprintf(buf, "{%d}", ++Cur_act);
       p = (SYMBOL *) newsym(sizeof(SYMBOL));
       strncpy(p->name, buf, NAME_MAX);
       addsym(Symtab, p);
 
+      p->kind = SYM_ACT;
       p->val = Cur_act;
       p->lineno = is_an_action;
 
-      if (!(p->string = strdup(object))) {
+      if (!(p->string = mem_strdup(MEM_ACTIONS, object))) {
         lerror(FATAL, "no memory to save action\n");
       }
     }
   }
 
   p->used = yylineno;
-  if ((i = p_cur_sym->rhs->rhs_len++) >= MAXRHS) {
-    lerror(NONFATAL, "right-hand side too long (%d max)\n", MAXRHS);
-  } else {
-    if (ISTERM(p)) {
-      p_cur_sym->rhs->prec = Precedence[p->val].level;
+
+  if (prod->rhs_len + 1 >= prod->rhs_max) { /* leave room for the NULL */
+    prod->rhs_max += RHS_CHUNK;
+    if (!(prod->rhs = (SYMBOL **) mem_realloc(MEM_PRODS, prod->rhs, prod->rhs_max * sizeof(SYMBOL *)))) {
+      lerror(FATAL, "no memory for right-hand side\n");
     }
+  }
+
+  if (ISTERM(p)) {
+    prod->prec = Precedence[p->val].level;
+  }
 
-    p_cur_sym->rhs->rhs[i] = p;
-    p_cur_sym->rhs->rhs[i + 1] = NULL; /* null terminal the array */
+  prod->rhs[prod->rhs_len++] = p;
+  prod->rhs[prod->rhs_len] = NULL; /* null terminal the array */
 
-    if (!ISACT(p)) {
-      ++(p_cur_sym->rhs->non_acts);
-    }
+  if (!ISACT(p)) {
+    ++(prod->non_acts);
   }
 }
 
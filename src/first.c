@@ -8,6 +8,7 @@
  */
 
 static int diff;
+static SET *Scratch = NULL;   /* used by first_closure() while first() runs */
 
 void first_closure(SYMBOL *lhs)
 {
@@ -27,17 +28,13 @@ void first_closure(SYMBOL *lhs)
 
   PRODUCTION *prod;       /* pointer to one production side */
   SYMBOL **y;             /* pointer to one element of production */
-  static SET *set = NULL; 
+  SET *set = Scratch;
   int i;
 
   if (!ISNONTERM(lhs)) { /* ignore entries for terminal symbols */
     return;
   }
 
-  if (!set) {
-    set = newset();
-  }
-
   ASSIGN(set, lhs->first);
   
   for (prod = lhs->productions; prod; prod = prod->next) {
@@ -72,10 +69,14 @@ void first_closure(SYMBOL *lhs)
 void first()
 {
   /* construct FIRST sets for all nonterminal symbols in the symbol table */
+
+  Scratch = newset();
   do {
     diff = 0;
     ptab(Symtab, (ptab_t)first_closure, NULL, 0);
   } while (diff);
+  delset(Scratch);
+  Scratch = NULL;
 }
 
 int first_rhs(SET *dest, SYMBOL **rhs, int len)
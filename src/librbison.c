@@ -0,0 +1,456 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <compiler.h>
+#include <l.h>
+#include "parser.h"
+#include "rbison.h"
+
+/*
+ * librbison.c: rbison as a library, see rbison.h. rbison_build() runs the
+ * same phases as do_file() in main.c on a grammar that's in a string, up to
+ * the tables, which write_tabfile() (yystate.c) leaves in memory instead of
+ * in BIN_FILE. the messages that would go to stdout are kept in the RBISON,
+ * and a fatal error ends the build rather than the program. nothing is
+ * written to a file.
+ *
+ * the generator keeps its state in globals, so builds are serialized: only
+ * one grammar is made at a time, rbison_build() holds Build_lock while it
+ * runs, and a thread that calls it while another one is building waits for
+ * it. the states are made on that thread alone (-j1), so a fatal error,
+ * which longjmp()s back to rbison_build(), always happens on it. the
+ * generator's memory is tracked (see mem_track() in lib/memory.c) and all of it is
+ * given back when the build is over, after the results have been copied
+ * into the RBISON, so a program that runs for a long time can make any
+ * number of grammars. the rest of the functions only use the RBISON (or the
+ * tables) that they're given, so different ones can be used on different
+ * threads at the same time, and a grammar can be parsed with on several
+ * threads at once.
+ *
+ * librbison.a is one object, made with ld -r, that only exports the
+ * rbison_ functions (see the makefile), so rbison's own yyparse(), yylex(),
+ * yylval and the rest of its globals don't clash with a program's. the
+ * grammar is read with the lex input routines (ii_newfile() and the
+ * rest, in libl.a), whose open, close and read functions are put back the
+ * way they were when the build is over. don't call rbison_build() while a
+ * lexer that uses them is part way through its input.
+ */
+
+struct _rbison_ {
+  char *image;                /* the tables, laid out as in BIN_FILE */
+  RBISON_TABLES tables;       /* pointers into image */
+  char **prods;               /* production_str() of each production */
+  char *messages;             /* from the last build */
+  size_t msgsize;
+};
+
+static pthread_mutex_t Build_lock = PTHREAD_MUTEX_INITIALIZER;
+static jmp_buf Fatal;         /* error(FATAL) goes back here */
+
+/* the grammar is given to the lexer through ii_io(). TEXT_FD stands for it,
+ * any other descriptor is one that the program's own functions opened
+ */
+
+#define TEXT_FD 0x7ffffffe
+
+extern int (*Openp)(char *, int);     /* lib/input.c */
+extern int (*Closep)(int);
+extern int (*Readp)(int, void *, unsigned int);
+
+static int (*Old_open)(char *, int);
+static int (*Old_close)(int);
+static int (*Old_read)(int, void *, unsigned int);
+
+static char *Text;            /* what's left of the grammar */
+static size_t Text_left;
+
+static int text_open(char *name, int mode)
+{
+  return TEXT_FD;
+}
+
+static int text_close(int fd)
+{
+  return fd == TEXT_FD ? 0 : (*Old_close)(fd);
+}
+
+static int text_read(int fd, void *buf, unsigned int n)
+{
+  if (fd != TEXT_FD) {
+    return (*Old_read)(fd, buf, n);
+  }
+
+  n = min(n, Text_left);
+  memcpy(buf, Text, n);
+  Text += n;
+  Text_left -= n;
+  return n;
+}
+
+static void fatal(void)
+{
+  longjmp(Fatal, 1);
+}
+
+static void input_fatal(char *msg)
+{
+  /* ferr() calls this instead of exit() while a grammar is read, the input
+   * functions in libl.a use it when they give up
+   */
+
+  error(FATAL, "%s", msg);
+}
+
+static void forget_tables(RBISON *rb)
+{
+  int i;
+
+  if (rb->prods) {
+    for (i = 0; i < rb->tables.nprods; ++i) {
+      free(rb->prods[i]);
+    }
+  }
+  free(rb->prods);
+  free(rb->tables.tokens);
+  free(rb->image);
+  rb->prods = NULL;
+  rb->image = NULL;
+  memset(&rb->tables, 0, sizeof(rb->tables));
+}
+
+static void forget(RBISON *rb)
+{
+  /* free the results of the last build */
+
+  forget_tables(rb);
+  free(rb->messages);
+  rb->messages = NULL;
+  rb->msgsize = 0;
+}
+
+static void name_prods(SYMBOL *sym, RBISON *rb)
+{
+  PRODUCTION *prod;
+
+  if (ISNONTERM(sym)) {
+    for (prod = sym->productions; prod; prod = prod->next) {
+      rb->prods[prod->num] = strdup(production_str(prod));
+    }
+  }
+}
+
+static int keep(RBISON *rb)
+{
+  /* copy the tables that write_tabfile() left in Tab_image, and the names
+   * of the productions, into rb. they're allocated with malloc(), not
+   * mem_alloc(), which would track them. return 0 if there's no memory.
+   */
+
+  TABHDR *h = (TABHDR *) Tab_image;
+  RBISON_TABLES *t = &rb->tables;
+  int i;
+
+  if (!(rb->image = (char *) malloc(Tab_size))
+        || !(t->tokens = (char **) malloc(h->ntoks * sizeof(char *)))
+        || !(rb->prods = (char **) calloc(h->nprods, sizeof(char *)))) {
+    return 0;
+  }
+
+  memcpy(rb->image, Tab_image, Tab_size);
+  t->nstates = h->nstates;
+  t->ntoks   = h->ntoks;
+  t->nprods  = h->nprods;
+  t->action  = (int *)   (rb->image + h->action);
+  t->goto_   = (int *)   (rb->image + h->goto_);
+  t->pool    = (short *) (rb->image + h->pool);
+  t->lhs     = (int *)   (rb->image + h->lhs);
+  t->reduce  = (int *)   (rb->image + h->reduce);
+  for (i = 0; i < h->ntoks; ++i) {
+    t->tokens[i] = rb->image + h->strings + ((int *) (rb->image + h->stokoff))[i];
+  }
+
+  ptab(Symtab, (ptab_t)name_prods, rb, 0);
+  for (i = 0; i < h->nprods; ++i) {
+    if (!rb->prods[i]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+RBISON *rbison_new()
+{
+  /* make an RBISON, NULL if there's no memory */
+
+  return (RBISON *) calloc(1, sizeof(RBISON));
+}
+
+void rbison_free(RBISON *rb)
+{
+  if (rb) {
+    forget(rb);
+    free(rb);
+  }
+}
+
+int rbison_build(RBISON *rb, char *name, char *grammar)
+{
+  /* make the tables for grammar, the text of a .y file. name is what the
+   * messages call it. return the number of errors: 0 if the tables were
+   * made, rbison_tables() then returns them. what rbison would have printed
+   * (the warnings too) is in rbison_messages() either way. the tables and
+   * messages of the last build are thrown away first.
+   */
+
+  static char unnamed[] = "grammar";
+  extern int yyparse(void);   /* parser.c */
+  void nows(void);            /* parser.l */
+  FILE *msgs;
+  int nerrs;
+
+  if (!name) {                /* ii_newfile() would read stdin */
+    name = unnamed;
+  }
+
+  pthread_mutex_lock(&Build_lock);
+  forget(rb);
+
+  if (!(msgs = open_memstream(&rb->messages, &rb->msgsize))) {
+    pthread_mutex_unlock(&Build_lock);
+    return 1;
+  }
+  if (!(Output = fopen("/dev/null", "w"))) {   /* the actions and #defines go nowhere */
+    fprintf(msgs, "ERROR: can't open /dev/null\n");
+    fclose(msgs);
+    pthread_mutex_unlock(&Build_lock);
+    return 1;
+  }
+
+  Library = 1;
+  Msg_file = msgs;
+  On_fatal = fatal;
+  Input_file_name = name;
+  Make_tabfile = 1;
+  Make_actions = 0;
+  No_lines = 1;
+  Threads = 1;                /* see above */
+  yynerrs = 0;
+
+  Text = grammar;
+  Text_left = strlen(grammar);
+  Old_open = Openp;
+  Old_close = Closep;
+  Old_read = Readp;
+  ii_io(text_open, text_close, text_read);
+  On_ferr = input_fatal;
+
+  mem_track(1);
+  if (!setjmp(Fatal)) {
+    if (!Text_left) {
+      error(FATAL, "%s is empty\n", name);
+    }
+    ii_unterm();              /* put back what the last lexeme's '\0' replaced */
+    ii_newfile(name);
+    ii_advance();             /* as the lexer does the first time it's called */
+    ii_pushback(1);
+
+    init_acts();
+    nows();
+    yyparse();
+    if (!problems()) {
+      first();
+      patch();
+      make_parse_tables();
+      if (!yynerrs && Tab_image && !keep(rb)) {
+        error(NONFATAL, "no memory for the tables\n");
+      }
+    }
+  }
+
+  if (!(nerrs = yynerrs) && !rb->image) {   /* make_parse_tables() gave up */
+    nerrs = 1;
+  }
+  if (nerrs) {
+    forget_tables(rb);
+  }
+
+  mem_release();
+  newsym_reset();
+  intern_reset();
+  reset_lr();
+  Tab_image = NULL;
+  Symtab = NULL;
+
+  ii_unterm();
+  ii_newfile(NULL);
+  ii_io(Old_open, Old_close, Old_read);
+  On_ferr = NULL;
+
+  fclose(Output);
+  Output = NULL;
+  On_fatal = NULL;
+  Msg_file = NULL;
+  fclose(msgs);               /* rb->messages is complete now */
+
+  pthread_mutex_unlock(&Build_lock);
+  return nerrs;
+}
+
+char *rbison_messages(RBISON *rb)
+{
+  /* what the last build printed, "" if nothing */
+
+  return rb->messages ? rb->messages : "";
+}
+
+RBISON_TABLES *rbison_tables(RBISON *rb)
+{
+  /* the tables made by the last build, NULL if it failed */
+
+  return rb->image ? &rb->tables : NULL;
+}
+
+int rbison_token(RBISON *rb, char *name)
+{
+  /* the number of the token called name, -1 if there's none */
+
+  int i;
+
+  for (i = 0; rb->image && i < rb->tables.ntoks; ++i) {
+    if (!strcmp(rb->tables.tokens[i], name)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+char *rbison_production(RBISON *rb, int prod)
+{
+  /* production prod as "lhs -> rhs...", NULL if there's none. an action in
+   * the middle of a right-hand side is a production of its own, with an
+   * epsilon right-hand side.
+   */
+
+  return (rb->image && prod >= 0 && prod < rb->tables.nprods) ? rb->prods[prod] : NULL;
+}
+
+static int next(RBISON_TABLES *t, int *rows, int state, int sym, int *act)
+{
+  /* find sym in the row for state. return 1 and put the action in *act if
+   * it's there, return 0 if it isn't.
+   */
+
+  short *p;
+  int i;
+
+  if (rows[state] >= 0) {
+    p = t->pool + rows[state];
+    for (i = *p++; --i >= 0; p += 2) {
+      if (p[0] == sym) {
+        *act = p[1];
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+typedef struct _stack_ {      /* rbison_parse()'s state and value stacks */
+  int *states;
+  void **vals;
+  int sp;                     /* # of items on them */
+  int max;                    /* room for this many */
+} STACK;
+
+static int push(STACK *s, int state, void *val)
+{
+  /* return 0 if there's no memory */
+
+  int *states, max;
+  void **vals;
+
+  if (s->sp >= s->max) {
+    max = s->max ? s->max * 2 : 64;
+    if (!(states = (int *) realloc(s->states, max * sizeof(int)))) {
+      return 0;
+    }
+    s->states = states;
+    if (!(vals = (void **) realloc(s->vals, max * sizeof(void *)))) {
+      return 0;
+    }
+    s->vals = vals;
+    s->max = max;
+  }
+
+  s->states[s->sp] = state;
+  s->vals[s->sp++] = val;
+  return 1;
+}
+
+int rbison_parse(RBISON_TABLES *t, RBISON_LEX lex, RBISON_REDUCE reduce, void *user, void **result)
+{
+  /* parse the tokens that lex returns with the tables t, calling reduce for
+   * each reduction. the value of the goal symbol goes in *result (if result
+   * isn't NULL). return 0 if the input was accepted, -1 at the first token
+   * that there's no action for (there's no error recovery), -2 if there's
+   * no memory, or what reduce returned if it wasn't 0. the stacks grow as
+   * they need to, so there's no limit on the depth.
+   */
+
+  STACK s;
+  void *lval = NULL, *val;
+  int tok, act, prod, n, status = -2;
+
+  memset(&s, 0, sizeof(s));
+  if (!push(&s, 0, NULL)) {
+    return -2;
+  }
+
+  tok = (*lex)(user, &lval);
+
+  for (;;) {
+    if (!next(t, t->action, s.states[s.sp - 1], tok, &act)) {
+      status = -1;
+      break;
+    }
+
+    if (act > 0) {              /* shift */
+      if (!push(&s, act, lval)) {
+        status = -2;
+        break;
+      }
+      lval = NULL;
+      tok = (*lex)(user, &lval);
+      continue;
+    }
+
+    prod = -act;                /* reduce, or accept if it's production 0 */
+    n = t->reduce[prod];
+    val = s.vals[n ? s.sp - n : s.sp - 1];    /* $$ = $1 */
+    if ((status = (*reduce)(user, prod, s.vals + s.sp - n, n, &val))) {
+      break;
+    }
+    if (!prod) {
+      if (result) {
+        *result = val;
+      }
+      break;
+    }
+
+    s.sp -= n;
+    if (!next(t, t->goto_, s.states[s.sp - 1], t->lhs[prod], &act)) {
+      status = -1;              /* can't happen unless the tables are broken */
+      break;
+    }
+    if (!push(&s, act, val)) {
+      status = -2;
+      break;
+    }
+  }
+
+  free(s.states);
+  free(s.vals);
+  return status;
+}
@@ -21,6 +21,7 @@ static FILE *Doc_file       = NULL;   /* error log & machine description */
 #define RBISON_VERSION "0.02"
 
 #define VERBOSE(str)  if (Verbose) { printf( "%s:\n", (str)); } else
+#define MESSAGES      (Msg_file ? Msg_file : stdout)
 
 /*
  * subroutine: 
@@ -73,15 +74,15 @@ void lerror(int fatal, char *fmt, ...)
     if (No_warnings) {
       return;
     }
-    fprintf(stdout, "%s WARNING (%s, line %d): ", PROG_NAME, Input_file_name, yylineno);
+    fprintf(MESSAGES, "%s WARNING (%s, line %d): ", PROG_NAME, Input_file_name, yylineno);
   } else if (fatal != NOHDR) {
     ++yynerrs;
-    fprintf(stdout, "%s ERROR (%s, line %d): ", PROG_NAME, Input_file_name, yylineno);
+    fprintf(MESSAGES, "%s ERROR (%s, line %d): ", PROG_NAME, Input_file_name, yylineno);
   }
 
   va_start(args, fmt);
-  vfprintf(stdout, fmt, args);
-  fflush(stdout);
+  vfprintf(MESSAGES, fmt, args);
+  fflush(MESSAGES);
   
   if (Verbose && Doc_file) {
     if (fatal != NOHDR) {
@@ -91,10 +92,23 @@ void lerror(int fatal, char *fmt, ...)
   }
 
   if (fatal == FATAL) {
-    exit(EXIT_OTHER);
+    give_up();
   }
 }
 
+void give_up()
+{
+  /* end the program after a fatal error, or the build if On_fatal is set
+   * (see librbison.c). with -j, the other threads are stopped first.
+   */
+
+  lr_fatal();
+  if (On_fatal) {
+    (*On_fatal)();
+  }
+  exit(EXIT_OTHER);
+}
+
 void error(int fatal, char *fmt, ...)
 {
   /* this error routine works like lerror() except that no line number is
@@ -109,16 +123,16 @@ void error(int fatal, char *fmt, ...)
       return;
     }
     type = "WARNING: ";
-    fprintf(stdout, type);
+    fprintf(MESSAGES, type);
   } else if (fatal != NOHDR) { /* if NOHDR is true. just act like printf*/
     ++yynerrs;
     type = "ERROR: ";
-    fprintf(stdout, type);
+    fprintf(MESSAGES, type);
   }
 
   va_start(args, fmt);
-  vfprintf(stdout, fmt, args);
-  fflush(stdout);
+  vfprintf(MESSAGES, fmt, args);
+  fflush(MESSAGES);
 
   if (Verbose && Doc_file) {
     va_start(args, fmt);
@@ -127,7 +141,7 @@ void error(int fatal, char *fmt, ...)
   }
 
   if (fatal == FATAL) {
-    exit(EXIT_OTHER);
+    give_up();
   }
 }
 
@@ -143,8 +157,16 @@ void parse_args(int argc, char *argv[])
     "  input file. legal command-line options are:",
     "",
     "-a   output actions only (see -p)",
+    "-b   write the tables to y.tab.bin, which the parser maps into memory",
+    "     when it starts, rather than compiling them in (overrides -T)",
+    "-B   like -b, but the assembler builds y.tab.bin into the parser (.incbin)",
+    "-c   reuse the tables in y.cache if only the actions have changed",
+    "-j<n> use <n> threads to make the LALR(1) states (-j alone: one per processor)",
     "-l   suppress #(L)ine directives",
+    "-m<file> use <file> as the driver template instead of the built-in one",
     "-p   output parser only (can be used with -T also)",
+    "-q<n|f|l> work on unfinished LALR(1) states lowest (n)umber first (the",
+    "     default), (f)irst in first out, or (l)ast in first out",
     "-s   make (s)ymbol table",
     "-S   make more-complete (S)ymbol table",
     "-t   print all (T)ables (and the parser) to standard output",
@@ -153,6 +175,10 @@ void parse_args(int argc, char *argv[])
     "-V   more verbose than -v. implies -t, & y.output goes to stderr",
     "-w   suppress all warning messages",
     "-W   warnings (as well as errors) generate nonzero exit status",
+    "--stats[=json] print the time and memory used by each phase, and various counts,",
+    "     to standard error as a table or as JSON",
+    "--profile=<file> order the tables by the counts in <file>, made by a parser",
+    "     compiled with -DYYPROFILE (see yyprofile())",
     NULL
   };
 
@@ -162,14 +188,48 @@ void parse_args(int argc, char *argv[])
    */
   
   for (++argv, --argc; argc && *(p = *argv) == '-'; ++argv, --argc) {
+    if (!strcmp(p, "--stats") || !strcmp(p, "--stats=table")) {
+      Stats = STATS_TABLE;
+      continue;
+    } else if (!strcmp(p, "--stats=json")) {
+      Stats = STATS_JSON;
+      continue;
+    } else if (!strncmp(p, "--profile=", 10)) {
+      if (!*(Profile_file = p + 10)) {
+        fprintf(stderr, "--profile needs a file name\n");
+        printv(stderr, usage_msg);
+        exit(EXIT_ILLEGAL_ARG);
+      }
+      continue;
+    }
+
     while (*++p) {
       switch (*p) {
-        case 'a': Make_parser = 0;
-                  Template = ACT_TEMPL;
-                  break;
+        case 'a': Make_parser = 0;  break;
+        case 'b': Make_tabfile = 1; break;
+        case 'B': Make_tabfile = 2; break;
+        case 'c': Use_cache = 1;    break;
         case 'g': Public = 1;       break;
+        case 'j': Threads = (int) strtol(p + 1, NULL, 10); /* -j<n>, 0 if no n */
+                  p += strlen(p) - 1;
+                  break;
         case 'l': No_lines = 1;     break;
+        case 'm': Template = p + 1; /* -m<file>, the rest of the argument */
+                  if (!*Template) {
+                    fprintf(stderr, "-m needs a file name\n");
+                    printv(stderr, usage_msg);
+                    exit(EXIT_ILLEGAL_ARG);
+                  }
+                  p += strlen(p) - 1;
+                  break;
         case 'p': Make_actions = 0; break;
+        case 'q': Work_order = *++p;  /* -qn, -qf or -ql */
+                  if (!Work_order || !strchr("nfl", Work_order)) {
+                    fprintf(stderr, "-q needs n, f or l\n");
+                    printv(stderr, usage_msg);
+                    exit(EXIT_ILLEGAL_ARG);
+                  }
+                  break;
         case 's': Symbols = 1;      break;
         case 'S': Symbols = 2;      break;
         case 't': Use_stdout  = 1;  break;
@@ -223,10 +283,12 @@ void statistics(FILE *fp)
   
   if (Verbose) {
     fprintf(fp, "\n");
-    fprintf(fp, "%4d/%-4d terminals\n",    USED_TERMS, NUMTERMS);
-    fprintf(fp, "%4d/%-4d nonterminals\n", USED_NONTERMS, NUMNONTERMS);
-    fprintf(fp, "%4d/%-4d productions\n",  Num_productions, MAXPROD);
+    fprintf(fp, "%4d  terminals\n",    USED_TERMS);
+    fprintf(fp, "%4d  nonterminals\n", USED_NONTERMS);
+    fprintf(fp, "%4d  productions\n",  Num_productions);
     lr_stats(fp);
+    print_memory(fp);
+    fprintf(fp, "\n");
   }
 
   conflicts = lr_conflicts(fp);
@@ -324,7 +386,9 @@ static void tail()
 
 int do_file()
 {
-  /* process the input file. return the number of errors */
+  /* process the input file. return the number of errors. the phases are
+   * timed for --stats (make_parse_tables() times its own).
+   */
 
   struct timeval start_time, end_time;
   long time;
@@ -333,6 +397,7 @@ int do_file()
   gettimeofday(&start_time, NULL); /* initialize times now so that the difference */
   end_time = start_time;           /* between times will be 0 if we don't build the tables */
 
+  stats_start(PH_PARSE);
   init_acts();
   file_header();
 
@@ -340,12 +405,20 @@ int do_file()
 
   nows();     /* make lex ignore white space until ws() is called */
   yyparse();  /* parse the entire input file */
+  stats_stop(PH_PARSE);
   
   if (!yynerrs || problems()) { /* if no problems in the input file */
     VERBOSE("analyzing grammar");
-    first();        /* find FIRST sets */
+    stats_start(PH_FIRST);
+    if (!cache_lookup() || Symbols) { /* tables not in y.cache (-c), or y.sym needs them */
+      first();      /* find FIRST sets */
+    }
+    stats_stop(PH_FIRST);
+
+    stats_start(PH_PATCH);
     code_header();  /* print various #define to output file */
     patch();        /* patch up the grammar and output the actions */  
+    stats_stop(PH_PATCH);
 
     if (Make_parser) {
       VERBOSE("make tables");
@@ -355,11 +428,13 @@ int do_file()
     gettimeofday(&end_time, NULL);
     VERBOSE("copying driver");
     
+    stats_start(PH_DRIVER);
     driver();     /* the parser */
     
     if (Make_actions) {
       tail();     /* and the tail end of the source file */
     }
+    stats_stop(PH_DRIVER);
   }
 
   if (Verbose) {
@@ -371,9 +446,12 @@ int do_file()
   return yynerrs;
 }
 
+/* librbison.a has everything above, but not main(). see librbison.c */
 
+#ifndef LIBRBISON
 int main(int argc, char *argv[])
 {
+  init_stats();            /* name the memory categories */
   signon();                /* print sign on message */
   signal(SIGINT, onintr);  /* close output files on ctrl-break */
   parse_args(argc, argv);
@@ -408,6 +486,13 @@ int main(int argc, char *argv[])
     if (Verbose && Doc_file) {
       statistics(Doc_file);
     }
+
+    if (Stats) {
+      if (Make_parser) {
+        lr_counters();
+      }
+      print_stats(stderr);
+    }
   } else {
     if (Output != stdout) {
       fclose(Output);
@@ -426,6 +511,7 @@ int main(int argc, char *argv[])
   
   return 0;
 }
+#endif
 
 #ifdef NEVER 
 int main(int argc, char *argv[]) {
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/*
+ * mkpar.c: convert driver templates (rbison.par, rbison-act.par) to C source
+ * so that they can be compiled into rbison. usage is:
+ *
+ *      mkpar name file [name file...] > partab.c
+ *
+ * each file is split into sections at the lines that start with a '?' and the
+ * '@' comment lines are discarded, just as driver_2() in lib/driver.c does when
+ * it reads a template at run time. every section is written out twice: once
+ * with the #line directives that driver_2() would print, and once without them
+ * (for -l). a TEMPLATE called "name" is created for each file.
+ */
+
+#define MAXLINE 2048  /* maximum length of a template line */
+
+static int Lineno;    /* line number in the current template file */
+
+static int getline_(FILE *fp, char *buf)
+{
+  /* read one line, including the newline, into buf. return the number of
+   * characters read (0 at end of file).
+   */
+
+  int c, n = 0;
+
+  while (n < MAXLINE - 1 && (c = getc(fp)) != EOF) {
+    buf[n++] = c;
+    if (c == '\n') {
+      break;
+    }
+  }
+
+  buf[n] = '\0';
+  return n;
+}
+
+static void pstring(FILE *out, char *str)
+{
+  /* print str as the body of a C string constant */
+
+  int prev = 0;
+
+  for (; *str; prev = *str++) {
+    switch (*str) {
+      case '\\': fputs("\\\\", out); break;
+      case '"':  fputs("\\\"", out); break;
+      case '\n': fputs("\\n", out);  break;
+      case '\t': fputs("\\t", out);  break;
+      case '?':  fputs(prev == '?' ? "\\?" : "?", out); break; /* no trigraphs */
+      default:
+        if (isprint((unsigned char)*str)) {
+          putc(*str, out);
+        } else {
+          fprintf(out, "\\%03o", (unsigned char)*str);
+        }
+        break;
+    }
+  }
+}
+
+static void pline(FILE *out, char *fmt, int lineno, char *file_name)
+{
+  /* print a #line directive as a C string constant */
+
+  char buf[MAXLINE];
+
+  sprintf(buf, fmt, lineno, file_name);
+  fputs("  \"", out);
+  pstring(out, buf);
+  fputs("\"\n", out);
+}
+
+static int section(FILE *in, FILE *out, int lines, char *file_name)
+{
+  /* copy one section of the template to out as a C string constant. the
+   * logic mirrors driver_2(). return 0 if the end of file was reached.
+   */
+
+  static char buf[MAXLINE];
+  char *p;
+  int processing_comment = 0;
+  int got;
+
+  if (lines) {
+    pline(out, "\n#line %d \"%s\"\n", Lineno + 1, file_name);
+  }
+
+  fputs("  \"\"\n", out);   /* the section may be empty */
+
+  while ((got = getline_(in, buf))) {
+    ++Lineno;
+    if (*buf == '?') {
+      return 1;
+    }
+
+    for (p = buf; isspace((unsigned char)*p); ++p) {
+      ;
+    }
+
+    if (*p == '@') {
+      processing_comment = 1;
+      continue;
+    } else if (processing_comment) {
+      processing_comment = 0;
+      if (lines) {
+        pline(out, "\n#line %d \"%s\"\n", Lineno, file_name);
+      }
+    }
+
+    fputs("  \"", out);
+    pstring(out, buf);
+    fputs("\"\n", out);
+  }
+
+  return 0;
+}
+
+static void sections(FILE *in, FILE *out, char *name, char *suffix, int lines, char *file_name)
+{
+  int more;
+  int n = 0;
+
+  rewind(in);
+  Lineno = 0;
+
+  fprintf(out, "static char *%s%s[] =\n{\n", name, suffix);
+
+  do {
+    fprintf(out, "  /* section %d */\n", n++);
+    more = section(in, out, lines, file_name);
+    fputs("  ,\n", out);
+  } while (more);
+
+  fprintf(out, "  NULL\n};\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+  FILE *in;
+  int i;
+
+  if (argc < 3 || !(argc & 1)) {
+    fprintf(stderr, "usage: mkpar name file [name file...]\n");
+    exit(1);
+  }
+
+  printf("/* generated by mkpar from the driver templates. do not edit */\n\n");
+  printf("#include <stdio.h>\n");
+  printf("#include <compiler.h>\n\n");
+
+  for (i = 1; i < argc; i += 2) {
+    if (!(in = fopen(argv[i + 1], "r"))) {
+      perror(argv[i + 1]);
+      exit(1);
+    }
+
+    sections(in, stdout, argv[i], "_lines", 1, argv[i + 1]);
+    sections(in, stdout, argv[i], "_nolines", 0, argv[i + 1]);
+
+    printf("TEMPLATE %s = { \"%s\", %s_lines, %s_nolines };\n\n",
+            argv[i], argv[i + 1], argv[i], argv[i]);
+    fclose(in);
+  }
+
+  return 0;
+}
@@ -12,40 +12,40 @@
 
 #define EXIT_ILLEGAL_ARG 255 /* illegal command-line switch */
 #define EXIT_TOO_MANY    254 /* too many command-line args */
-#define EXIT_NO_DRIVER   253 /* can't find rbison.par */
+#define EXIT_NO_DRIVER   253 /* can't find the template given with -m */
 #define EXIT_OTHER       252 /* other error (syntax error, etc) */
 #define EXIT_USR_ABRT    251 /* ctrl-break */
 
 
 #define MAXNAME     32  /* maximum length of a terminal or nonterminal name */
-#define MAXPROD     512 /* maximum number of productions */
 #define MINTERM     1   /* token values assigned to terminals start here */
-#define MINNONTERM  256 /* nonterminals start here */
-#define MINACT      512 /* acts start here */
 
-/* 
- * maximum numeric values used for terminals and nonterminals (MAXTERM and MAXNONTERM), as
- * well as the maximum number of terminals and nonterminals (NUMTERMS and NUMNONTERMS).
- * finally, USED_TERMS and USED_NONTERMS are the number of these actually in use (i.e.
- * were declared in the input file).
+/*
+ * there are no fixed limits on the number of symbols or productions. terminals
+ * are numbered from MINTERM up, in the order that they're declared. EPSILON
+ * comes next, and the nonterminals follow, starting at Min_nonterm. that value
+ * isn't known until all the terminals have been declared, so it's fixed by
+ * first_sym() at the %% (nonterminals that are created earlier, by %type, are
+ * numbered then). actions are numbered separately from 0 and become nonterminals
+ * in patch(). Terms[] and Precedence[] grow as values are handed out (see
+ * set_val() in acts.c). USED_TERMS and USED_NONTERMS are the number of symbols
+ * of each kind that are in use.
  */
 
-#define MAXTERM     (MINNONTERM - 2)
-#define MAXNONTERM  (MINACT - 1)
-
-#define NUMTERMS    ((MAXTERM - MINTERM) + 1)
-#define NUMNONTERMS ((MAXNONTERM - MINNONTERM) + 1)
-
 #define USED_TERMS    ((Cur_term - MINTERM) + 1)
-#define USED_NONTERMS ((Cur_nonterm - MINNONTERM) + 1)
+#define USED_NONTERMS ((Cur_nonterm - Min_nonterm) + 1)
 
 /* 
  * these macros evaluate to true if x represents a terminal (ISTERM), nonterminal (ISNONTERM)
  * or action (ISACT)
  */
-#define ISTERM(x)     ((x) && (MINTERM <= (x)->val && (x)->val <= MAXTERM))
-#define ISNONTERM(x)  ((x) && (MINNONTERM <= (x)->val && (x)->val <= MAXNONTERM))
-#define ISACT(x)      ((x) && (MINACT <= (x)->val))
+#define SYM_TERM    1   /* values for SYMBOL.kind */
+#define SYM_NONTERM 2
+#define SYM_ACT     3
+
+#define ISTERM(x)     ((x) && (x)->kind == SYM_TERM)
+#define ISNONTERM(x)  ((x) && (x)->kind == SYM_NONTERM)
+#define ISACT(x)      ((x) && (x)->kind == SYM_ACT)
 
 /* epsilon's value is one more than the largest terminal actually used. we can get away with
  * this only because EPSILON is not used until after all the terminals have been entered into 
@@ -59,8 +59,8 @@
  * the adjustment, UNADJ_VAL translates the adjust value back to the original value.
  */
 
-#define ADJ_VAL(x)    ((x) - MINNONTERM)
-#define UNADJ_VAL(x)  ((x) + MINNONTERM)
+#define ADJ_VAL(x)    ((x) - Min_nonterm)
+#define UNADJ_VAL(x)  ((x) + Min_nonterm)
 
 #define NONFATAL 0  /* values to pass to error() and lerror() */
 #define FATAL    1  /* defined in main.c */
@@ -72,12 +72,42 @@
 #define PARSE_FILE "y.tab.c"        /* output file for parser */
 #define ACT_FILE   "y.act.c"        /* used for output if -a specified */
 #define TAB_FILE   "y.outab.c"      /* output file for parser tables (-T) */
+#define BIN_FILE   "y.tab.bin"      /* binary parser tables (-b) */
 #define SYM_FILE   "y.sym"          /* output file for symbot table */
 #define DOC_FILE   "y.output"       /* LALR(1) state machine description */
-#define PAR_TEMPL  "rbison.par"     /* template file for PARSE_FILE */
-#define ACT_TEMPL  "rbison-act.par" /* template file for ACT_FILE */
+#define CACHE_FILE "y.cache"        /* tables saved by -c (see yycache.c) */
+#define PAR_TEMPL  "rbison.par"     /* template for PARSE_FILE (compiled in, see mkpar.c) */
+#define ACT_TEMPL  "rbison-act.par" /* template for ACT_FILE (compiled in, see mkpar.c) */
 #define PROG_NAME  "rbison"
 
+/* the header of BIN_FILE (see write_tabfile() in yystate.c). it has to agree
+ * with struct yytabhdr in rbison.par
+ */
+
+#define TABFILE_MAGIC   "rbtab"
+#define TABFILE_VERSION 1         /* YYTAB_VERSION in the driver */
+
+typedef struct _tabhdr_ {
+  char magic[8];
+  int version;
+  int byteorder;                  /* 0x01020304 */
+  int ttype_size;                 /* sizeof(YY_TTYPE) in the parser */
+  int size;                       /* of the file */
+  int nstates;
+  int nprods;
+  int ntoks;
+  int npool;                      /* # of shorts in the pool */
+  int nstrings;                   /* # of bytes of token names */
+  int action;                     /* offsets of the sections */
+  int goto_;
+  int pool;
+  int lhs;
+  int reduce;
+  int stokoff;
+  int strings;
+  unsigned int checksum;          /* FNV-1a of everything after the header */
+} TABHDR;
+
 /* 
  * the following are used to define types of the OUTPUT transition tables. the
  * ifndef takes care of compiling the rbison output file that will be used to
@@ -99,6 +129,7 @@ typedef struct _symbol_
   char name[NAME_MAX];        /* symbol name. must be first */
   char field[NAME_MAX];       /* %type <field> */
   unsigned int val;           /* numeric value of symbol */
+  unsigned int kind;          /* SYM_TERM, SYM_NONTERM or SYM_ACT */
   unsigned int used;          /* symbol used on an rhs */
   unsigned int set;           /* symbol defined */
   unsigned int lineno;        /* input line num of string */
@@ -110,18 +141,20 @@ typedef struct _symbol_
 #define NULLABLE(sym) (ISNONTERM(sym) && MEMBER((sym)->first, EPSILON))
 
 /* PRODUCTION structure. represents right-hand sides */
-#define MAXRHS  31   /* maximum number of objects on a right-hand side */
-#define RHSBITS 5    /* number of bits required to hold MAXRHS */
-
 typedef struct _prod_
 {
   unsigned int num;        /* production number */
-  SYMBOL *rhs[MAXRHS + 1]; /* tokenized right-hand side */
+  SYMBOL **rhs;            /* tokenized right-hand side, NULL terminated */
   SYMBOL *lhs;             /* left-hand side */
-  unsigned char rhs_len;   /* # of elements in rhs[] array */
-  unsigned char non_acts;  /* that are not actions */
+  int rhs_len;             /* # of elements in rhs[] array */
+  int rhs_max;             /* # of elements allocated for rhs[] */
+  int non_acts;            /* that are not actions */
   struct _prod_ *next;     /* pointer to next production for this left-hand side */ 
   int prec;                /* relative precedence */
+  int has_action;          /* yy_act() has a case for it */
+  int uses_text;           /* the action uses yytext, yyleng or yylineno (see yypatch.c) */
+  int sets_val;            /* the action starts by assigning $$ */
+  int in_place;            /* $$ is put in $1's place on the value stack */
 } PRODUCTION;
 
 typedef struct _prectab_
@@ -145,37 +178,52 @@ typedef struct _prectab_
 CLASS char *Input_file_name I( = "console" ); /* input file name */
 CLASS int Make_actions      I( = 1 );         /* == 0 if -p on command line */
 CLASS int Make_parser       I( = 1 );         /* == 0 if -a on command line */
+CLASS int Make_tabfile      I( = 0 );         /* == 1 if -b, 2 if -B on command line */
 CLASS int Make_yyoutab      I( = 0 );         /* == 1 if -T on command line */
 CLASS int No_lines          I( = 0 );         /* suppress #lines in output */ 
 CLASS int No_warnings       I( = 0 );         /* suppress warnings if true */
 CLASS FILE *Output;                           /* Output stream */
+CLASS char *Profile_file    I( = NULL );      /* --profile=<file>: counts made by a YYPROFILE parser */
 CLASS int Public            I( = 0 );         /* make static symbols public */
 CLASS int Symbols           I( = 0 );         /* generate symbol table */
+CLASS int Use_cache         I( = 0 );         /* -c: reuse the tables in CACHE_FILE */
+CLASS int Stats             I( = 0 );         /* --stats: STATS_TABLE, --stats=json: STATS_JSON */
 CLASS int Threshold         I( = 4 );         /* compression threshold */
+CLASS int Threads           I( = 1 );         /* -j: threads used to make the LALR(1) states */
 CLASS int Use_stdout        I( = 0 );         /* -t specified on command line */
+CLASS int Work_order        I( = 'n' );       /* -q: order of unfinished LALR(1) states (n, f or l) */
 CLASS int Verbose           I( = 0 );         /* Verbose-mode output (1 for -v and 2 for -V)*/
 
+/* set by librbison.c, which runs the generator without main() */
+
+CLASS int Library           I( = 0 );         /* == 1 when librbison.c is running */
+CLASS FILE *Msg_file        I( = NULL );      /* error() and lerror() print here, stdout if NULL */
+CLASS void (*On_fatal)(void) I( = NULL );     /* called by error(FATAL) instead of exit(), mustn't return */
+CLASS char *Tab_image       I( = NULL );      /* with Library, write_tabfile() leaves BIN_FILE's */
+CLASS int Tab_size          I( = 0 );         /* contents here instead of writing it */
+
 /* this array is indexed by terminal or nonterminal value and evaluates to a
- * pointer to the equivalent symbol-table entry.
+ * pointer to the equivalent symbol-table entry. it's grown by set_val().
  */
 
-CLASS SYMBOL *Terms[MINACT]; 
+CLASS SYMBOL **Terms I( = NULL ); 
 
 /* holds relative precedence and associativity information
  * for both terminals and nonterminals
  */
 
-CLASS PREC_TAB Precedence[MINNONTERM]; 
+CLASS PREC_TAB *Precedence I( = NULL ); 
 
-CLASS char *Template I( = PAR_TEMPL ); /* template file for the parser; can be modified in main.c */
+CLASS char *Template I( = NULL );      /* template file given with -m, NULL for the compiled-in one */
 CLASS HASH_TAB *Symtab;                /* the symbol table itself initialized in y.act.c */
 CLASS SYMBOL *Goal_symbol I( = NULL ); /* pointer to symbol-table entry for the start(goal) symbol */
  
 /* the following are used by the acts in y.act.c */
 
 CLASS int Cur_term        I( = MINTERM - 1);     /* current terminal */
-CLASS int Cur_nonterm     I( = MINNONTERM - 1);  /* current nonterminal */
-CLASS int Cur_act         I( = MINACT - 1);      /* current action */
+CLASS int Min_nonterm     I( = 0 );              /* first nonterminal, set by first_sym() */
+CLASS int Cur_nonterm     I( = -1 );             /* current nonterminal */
+CLASS int Cur_act         I( = -1 );             /* current action */
 CLASS int Num_productions I( = 0 );              /* number of productions */  
 
 #undef CLASS
@@ -207,6 +255,7 @@ void pact(SYMBOL *sym, FILE *stream);                 /* acts.c */
 void pnonterm(SYMBOL *sym, FILE *stream);             /* acts.c */
 void prec(char *name);                                /* acts.c */
 void prec_list(char *name);                           /* acts.c */
+void set_val(SYMBOL *sym, int val);                   /* acts.c */
 void print_symbols(FILE *stream);                     /* acts.c */
 void print_tok(FILE *stream, char *format, int arg);  /* acts.c */
 void pterm(SYMBOL *sym, FILE *stream);                /* acts.c */
@@ -215,11 +264,12 @@ void union_def(char *action);                         /* acts.c */
 
 int start_action(void); /* from lexical analyzer (parser.l) */
 
-char *do_dollar(int num, int rhs_size, int lineno, PRODUCTION *prod, char *fname); /* yydollar.c */
+char *do_dollar(int num, int rhs_size, int lineno, PRODUCTION *prod, char *fname, int in_place); /* yydollar.c */
 
 void document(char *fmt, ...);          /* main.c */
 void document_to(FILE *fp);             /* main.c */
 void error(int fatal, char *fmt, ...);  /* main.c */
+void give_up(void);                     /* main.c */
 void lerror(int fatal, char *fmt, ...); /* main.c */
 char *open_errmsg(void);                /* main.c */
 void output(char *fmt, ...);            /* main.c */
@@ -233,13 +283,57 @@ int first_rhs(SET* dest, SYMBOL **rhs, int len);  /* first.c */
 
 
 int lr_conflicts(FILE *fp);   /* yystate.c */
+void lr_counters(void);       /* yystate.c */
+void lr_fatal(void);          /* yystate.c */
+int lr_order(void);           /* yystate.c */
 void lr_stats(FILE *fp);       /* yystate.c */
 void make_parse_tables(void); /* yystate.c */
+void reset_lr(void);          /* yystate.c */
 
 void make_token_file(void);   /* stok.c */
 void make_yy_stok(void);      /* stok.c */
 
 
+int cache_get(void);      /* yycache.c */
+int cache_hit(void);      /* yycache.c */
+int cache_lookup(void);   /* yycache.c */
+void cache_put(int n);    /* yycache.c */
+void cache_save(void);    /* yycache.c */
+unsigned long long grammar_fingerprint(void); /* yycache.c */
+
+#define STATS_TABLE 1   /* values of Stats */
+#define STATS_JSON  2
+
+#define PH_PARSE  0     /* phases timed by --stats, see yystats.c */
+#define PH_FIRST  1
+#define PH_PATCH  2
+#define PH_LR     3
+#define PH_REDUCE 4
+#define PH_TABLES 5
+#define PH_DRIVER 6
+#define NPHASES   7
+
+/* memory categories, see lib/memory.c */
+#define MEM_PRODS   (MEM_USER + 0)  /* productions and the LR(0) item tables */
+#define MEM_ACTIONS (MEM_USER + 1)  /* the code in the actions */
+#define MEM_ITEMS   (MEM_USER + 2)  /* LALR(1) items */
+#define MEM_STATES  (MEM_USER + 3)  /* LALR(1) states and the lists of them */
+#define MEM_TABLES  (MEM_USER + 4)  /* rows of the action and goto tables */
+#define MEM_LR      (MEM_USER + 5)  /* closure buffers, workers, conflicts */
+#define MEM_OUTPUT  (MEM_USER + 6)  /* buffers used to print the tables, y.cache */
+
+void init_stats(void);                    /* yystats.c */
+void print_memory(FILE *fp);              /* yystats.c */
+void print_stats(FILE *fp);               /* yystats.c */
+void stats_count(char *name, long value); /* yystats.c */
+void stats_start(int phase);              /* yystats.c */
+void stats_stop(int phase);               /* yystats.c */
+
+int prof_load(int nstates);               /* yyprof.c */
+long prof_state(int state);               /* yyprof.c */
+long prof_action(int state, int token);   /* yyprof.c */
+long prof_goto(int state, int nonterm);   /* yyprof.c */
+
 void patch(void);   /* yypatch.c */
 void tables(void);  /* yycode.c */
 int yyparse(void);  /* llpar.c */
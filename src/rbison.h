@@ -0,0 +1,54 @@
+#ifndef _RBISON_H
+#define _RBISON_H
+
+/*
+ * rbison.h: rbison as a library (librbison.a, see librbison.c). a program
+ * makes the tables for a grammar at run time with rbison_build() and parses
+ * with them with rbison_parse(), which calls back for each token and each
+ * reduction. nothing is compiled: the actions in the grammar are ignored,
+ * the reduce callback does their work instead. builds are serialized, one
+ * at a time in the whole program, parses aren't.
+ */
+
+typedef struct _rbison_ RBISON;     /* a grammar and its tables */
+
+/* the tables made by rbison_build(). they're laid out as in the file that
+ * rbison -b writes. the row for a state is a count, then that many
+ * (symbol, action) pairs. in an action row the symbol is a token, and the
+ * action is the state to shift to if it's > 0, the production to reduce by
+ * if it's < 0 (-1 is production 1), and accept if it's 0. in a goto row the
+ * symbol is a left-hand side from lhs[] and the action is the next state.
+ */
+
+typedef struct _rbison_tables_ {
+  int nstates;
+  int ntoks;                  /* tokens, 0 (end of input) included */
+  int nprods;
+  int *action;                /* [nstates] action row of each state in pool, -1 if none */
+  int *goto_;                 /* [nstates] goto row of each state in pool, -1 if none */
+  short *pool;                /* the rows */
+  int *lhs;                   /* [nprods] left-hand side of each production */
+  int *reduce;                /* [nprods] # of symbols on each right-hand side */
+  char **tokens;              /* [ntoks] the name of each token */
+} RBISON_TABLES;
+
+/* rbison_parse() calls these. lex returns the next token (0 at the end of
+ * the input) and puts its value in *value. reduce is called with the values
+ * of the right-hand side, rhs[0] is $1, and puts $$ in *lhs, which is set
+ * to $1 (or, for an epsilon production, to the value on top of the stack)
+ * before the call. it returns 0 to go on, anything else stops the parse.
+ */
+
+typedef int (*RBISON_LEX)(void *user, void **value);
+typedef int (*RBISON_REDUCE)(void *user, int prod, void **rhs, int nrhs, void **lhs);
+
+RBISON *rbison_new(void);
+void rbison_free(RBISON *rb);
+int rbison_build(RBISON *rb, char *name, char *grammar);
+char *rbison_messages(RBISON *rb);
+RBISON_TABLES *rbison_tables(RBISON *rb);
+int rbison_token(RBISON *rb, char *name);
+char *rbison_production(RBISON *rb, int prod);
+int rbison_parse(RBISON_TABLES *tables, RBISON_LEX lex, RBISON_REDUCE reduce, void *user, void **result);
+
+#endif
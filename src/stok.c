@@ -16,8 +16,13 @@ void make_yy_stok()
     "Yy_stok[] is used for error messages. it is indexed",
     "by the internal value used for a token (as used for a column index in",
     "the transition matrix) and evaluates to a string naming that token",
+    NULL
   };
 
+  if (Make_tabfile) {   /* it's in BIN_FILE, see write_tabfile() in yystate.c */
+    return;
+  }
+
   comment(Output, the_comment);
 
   output("char *Yy_stok[] = \n{\n");
@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <set.h>
+#include <hash.h>
+#include <compiler.h>
+#include "parser.h"
+
+/*
+ * yycache.c: the grammar-fingerprint cache used by -c.
+ *
+ * most edits to a grammar only touch the code in the actions, and the LALR(1)
+ * tables don't depend on that code at all. a fingerprint of everything that
+ * the tables do depend on (the symbols, their precedence, the productions and
+ * the positions of the actions in them, the goal symbol) is computed as soon
+ * as the input file is parsed. if CACHE_FILE holds tables that were made for
+ * the same fingerprint, FIRST-set computation and the LR(0)/LALR(1) state
+ * machine construction are skipped and the tables are read from the cache
+ * instead. the rest of the output (the actions, the driver, y.tab.h) is
+ * always regenerated.
+ *
+ * the file is an unportable binary dump -- it's only meant to be reused by
+ * the same rbison on the same machine:
+ *
+ *      HEADER   magic, version, fingerprint, payload size and checksum
+ *      int[]    payload, written by make_parse_tables() (yystate.c)
+ *
+ * the cache is bypassed by -v and -V because y.output needs the states
+ * themselves, and by -a because no tables are made.
+ */
+
+#define CACHE_MAGIC   "rbcache"
+#define CACHE_VERSION 3         /* bump when the payload layout or the fingerprint changes */
+
+typedef struct _header_
+{
+  char magic[8];
+  int version;
+  int size;                       /* # of ints in the payload */
+  unsigned long long fingerprint; /* of the grammar */
+  unsigned long long checksum;    /* of the payload */
+} HEADER;
+
+static int Enabled = 0;               /* cache is in use for this run */
+static unsigned long long Fingerprint;
+
+static int *Tables = NULL;            /* payload read from CACHE_FILE */
+static int Tables_size;
+static int Next = 0;                  /* next int in Tables to return */
+
+static int *Newtab = NULL;            /* payload to write to CACHE_FILE */
+static int Newtab_size = 0;
+static int Newtab_max = 0;
+
+#define FNV_BASIS 14695981039346656037ULL /* 64-bit FNV-1a */
+#define FNV_PRIME 1099511628211ULL
+
+static unsigned long long hash_bytes(unsigned long long h, void *buf, int n)
+{
+  unsigned char *p = (unsigned char *) buf;
+
+  while (--n >= 0) {
+    h = (h ^ *p++) * FNV_PRIME;
+  }
+  return h;
+}
+
+static unsigned long long hash_int(unsigned long long h, int n)
+{
+  return hash_bytes(h, &n, sizeof(n));
+}
+
+static unsigned long long hash_str(unsigned long long h, char *str)
+{
+  return hash_bytes(h, str, strlen(str) + 1); /* include the '\0' */
+}
+
+static unsigned long long fingerprint()
+{
+  /* hash everything in the symbol table that the parse tables depend on.
+   * action symbols are identified by their value only, the code that
+   * they hold is ignored.
+   */
+
+  unsigned long long h = FNV_BASIS;
+  PRODUCTION *prod;
+  SYMBOL *sym;
+  int i, j;
+
+  h = hash_int(h, CACHE_VERSION);
+  h = hash_int(h, Cur_term);
+  h = hash_int(h, Cur_nonterm);
+  h = hash_int(h, Min_nonterm);
+  h = hash_int(h, Cur_act);
+  h = hash_int(h, Num_productions);
+  h = hash_int(h, Goal_symbol ? Goal_symbol->val : 0);
+  h = hash_int(h, lr_order() == 'l');  /* -ql numbers the states differently, -j doesn't use it */
+
+  for (i = MINTERM; i <= Cur_term; ++i) {
+    h = hash_str(h, Terms[i]->name);
+    h = hash_int(h, Precedence[i].level);
+    h = hash_int(h, Precedence[i].assoc);
+  }
+
+  for (i = Min_nonterm; i <= Cur_nonterm; ++i) {
+    sym = Terms[i];
+    h = hash_str(h, sym->name);
+
+    for (prod = sym->productions; prod; prod = prod->next) {
+      h = hash_int(h, prod->num);
+      h = hash_int(h, prod->prec);
+      h = hash_int(h, prod->rhs_len);
+      for (j = 0; j < prod->rhs_len; ++j) {
+        h = hash_int(h, prod->rhs[j]->kind);
+        h = hash_int(h, prod->rhs[j]->val);
+      }
+    }
+    h = hash_int(h, -1); /* end of the right-hand sides */
+  }
+
+  return h;
+}
+
+int cache_lookup()
+{
+  /* called once the input file has been parsed. fingerprint the grammar and
+   * load the cached tables if they were made for this grammar. return 1 if
+   * they were (make_parse_tables() should then use cache_get()), 0 otherwise.
+   * a missing, stale or damaged cache file is silently ignored.
+   */
+
+  FILE *fp;
+  HEADER hdr;
+
+  Fingerprint = fingerprint();  /* --profile checks it too */
+
+  if (!(Enabled = Use_cache && Make_parser && !Verbose)) {
+    return 0;
+  }
+
+  if (!(fp = fopen(CACHE_FILE, "rb"))) {
+    return 0;
+  }
+
+  if (fread(&hdr, sizeof(hdr), 1, fp) == 1
+        && !memcmp(hdr.magic, CACHE_MAGIC, sizeof(hdr.magic))
+        && hdr.version == CACHE_VERSION
+        && hdr.fingerprint == Fingerprint
+        && hdr.size > 0) {
+
+    if (!(Tables = (int *) mem_alloc(MEM_OUTPUT, hdr.size * sizeof(int)))) {
+      error(FATAL, "no memory for cached tables\n");
+    }
+
+    if (fread(Tables, sizeof(int), hdr.size, fp) != hdr.size
+          || hash_bytes(FNV_BASIS, Tables, hdr.size * sizeof(int)) != hdr.checksum) {
+      mem_free(Tables);
+      Tables = NULL;
+    } else {
+      Tables_size = hdr.size;
+    }
+  }
+
+  fclose(fp);
+  return Tables != NULL;
+}
+
+unsigned long long grammar_fingerprint()
+{
+  /* return the fingerprint computed by cache_lookup(). it's printed into the
+   * parser (see make_yy_prods() in yystate.c) so that a profile can be
+   * matched to the grammar that it was made with.
+   */
+
+  return Fingerprint;
+}
+
+int cache_hit()
+{
+  /* return true if make_parse_tables() should read the tables from the cache */
+
+  return Tables != NULL;
+}
+
+int cache_get()
+{
+  /* return the next int from the cached tables */
+
+  if (Next >= Tables_size) {
+    error(FATAL, "%s is damaged, remove it and try again\n", CACHE_FILE);
+  }
+  return Tables[Next++];
+}
+
+void cache_put(int n)
+{
+  /* add n to the tables to be written by cache_save(). does nothing if the
+   * cache isn't being used.
+   */
+
+  if (!Enabled) {
+    return;
+  }
+
+  if (Newtab_size >= Newtab_max) {
+    Newtab_max = Newtab_max ? Newtab_max * 2 : 1024;
+    if (!(Newtab = (int *) mem_realloc(MEM_OUTPUT, Newtab, Newtab_max * sizeof(int)))) {
+      error(FATAL, "no memory for table cache\n");
+    }
+  }
+  Newtab[Newtab_size++] = n;
+}
+
+void cache_save()
+{
+  /* write the tables collected by cache_put() to CACHE_FILE. the file is
+   * written under a temporary name and then renamed so that an interrupted
+   * run can't leave a half-written cache behind.
+   */
+
+  static char tmp_name[] = CACHE_FILE ".tmp";
+  FILE *fp;
+  HEADER hdr;
+  int ok;
+
+  if (!Enabled || !Newtab_size) {
+    return;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, CACHE_MAGIC, sizeof(hdr.magic));
+  hdr.version     = CACHE_VERSION;
+  hdr.size        = Newtab_size;
+  hdr.fingerprint = Fingerprint;
+  hdr.checksum    = hash_bytes(FNV_BASIS, Newtab, Newtab_size * sizeof(int));
+
+  if (!(fp = fopen(tmp_name, "wb"))) {
+    error(WARNING, "can't create %s, tables not cached\n", tmp_name);
+    return;
+  }
+
+  ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1
+        && fwrite(Newtab, sizeof(int), Newtab_size, fp) == Newtab_size;
+
+  if (fclose(fp) != 0 || !ok || rename(tmp_name, CACHE_FILE) != 0) {
+    remove(tmp_name);
+    error(WARNING, "can't write %s, tables not cached\n", CACHE_FILE);
+  }
+
+  mem_free(Newtab);
+  Newtab = NULL;
+  Newtab_size = Newtab_max = 0;
+}
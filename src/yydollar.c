@@ -2,30 +2,32 @@
 #include <string.h>
 #include "parser.h"
 
-char *do_dollar(int num, int rhs_size, int lineno, PRODUCTION *prod, char *fname)
+char *do_dollar(int num, int rhs_size, int lineno, PRODUCTION *prod, char *fname, int in_place)
 {
   /* num: the N is $N, DOLLAR_DOLLAR for $$
    * rhs_size: number of symbols on right-hand side
    * lineno: input line number for error messages
    * prod: production
    * fname: name in $<name>N
+   * in_place: $$ is $1's place on the value stack (see dollar_use() in
+   *           yypatch.c), not Yy_val
    */
 
   static char buf[128];
   int i, len;
 
   if (num == DOLLAR_DOLLAR) { /* Do $$ */
-    strcpy(buf, "Yy_val");
+    len = in_place ? sprintf(buf, "yyvsp[%d]", rhs_size - 1) : sprintf(buf, "Yy_val");
     
     if (*fname) {  /* $<name>N */
-      sprintf(buf + 6, ".%s", fname);
+      sprintf(buf + len, ".%s", fname);
     } else if (fields_active()) {
       if (*prod->lhs->field) {
-        sprintf(buf + 6, ".%s", prod->lhs->field);
+        sprintf(buf + len, ".%s", prod->lhs->field);
       } else {
         error(WARNING, "line %d: no <field> assigned to $$, ", lineno);
         error(NOHDR, "using default int field\n");
-        sprintf(buf + 6, ".%s", DEF_FIELD);
+        sprintf(buf + len, ".%s", DEF_FIELD);
       }
     }
   } else {
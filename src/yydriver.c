@@ -5,6 +5,9 @@
 
 static FILE *Driver_file;
 
+extern TEMPLATE Par_template; /* partab.c, made from rbison.par by mkpar */
+extern TEMPLATE Act_template; /* partab.c, made from rbison-act.par by mkpar */
+
 /* they MUST be called in the following order:
  * file_header()
  * code_header()
@@ -33,8 +36,17 @@ void file_header()
     output("#define YYPARSER\n");
   }
 
-  if (!(Driver_file = driver_1(Output, !No_lines, Template))) {
-    error(NONFATAL, "rbison.par not found--output file won't compile\n");
+  if (Make_parser && Make_tabfile) { /* see yy_load_tables() in the driver */
+    output("#ifndef YYTABFILE\n#define YYTABFILE \"%s\"\n#endif\n", BIN_FILE);
+    if (Make_tabfile == 2) {
+      output("#define YYTABINCBIN\n");
+    }
+  }
+
+  if (!Template) { /* use the template compiled into rbison */
+    driver_1t(Output, !No_lines, Make_parser ? &Par_template : &Act_template);
+  } else if (!(Driver_file = driver_1(Output, !No_lines, Template))) {
+    error(NONFATAL, "%s not found--output file won't compile\n", Template);
   }
 
 }
@@ -56,5 +68,8 @@ void driver(void)
     driver_2(Output, !No_lines);
   }
 
-  fclose(Driver_file);
+  if (Driver_file) {
+    fclose(Driver_file);
+    Driver_file = NULL;   /* librbison may make another grammar */
+  }
 }
\ No newline at end of file
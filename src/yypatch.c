@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 #include <compiler.h>
 #include "parser.h"
@@ -36,13 +37,146 @@ static int Last_real_nonterm; /* this is the number of the last
   |
 #endif
 
-static void print_one_case(int case_val, char *action, int rhs_size, int lineno, PRODUCTION *prod)
+static int uses_text(char *action)
+{
+  /* return true if the code in an action uses the lexeme that the driver
+   * sets up before a reduction: yytext, yyleng, yylineno, yyerror() (which
+   * prints yytext) or the ii_ input functions. the names are looked for as
+   * whole identifiers, also in comments and strings, so a false positive is
+   * possible but a miss isn't. code that the action calls isn't looked at.
+   */
+
+  static char *names[] = { "yytext", "yyleng", "yylineno", "yyerror", NULL };
+  char **np, *start;
+  int len;
+
+  while (*action) {
+    if (!isalpha(*action) && *action != '_') {
+      ++action;
+      continue;
+    }
+
+    for (start = action; isalnum(*action) || *action == '_'; ++action) {
+      ;
+    }
+    len = action - start;
+
+    if (len > 3 && !strncmp(start, "ii_", 3)) {
+      return 1;
+    }
+    for (np = names; *np; ++np) {
+      if (len == strlen(*np) && !strncmp(start, *np, len)) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+static char *skip_dollar(char *action, int *num)
+{
+  /* action points at a '$'. put the N of $N or $<name>N in *num (0 for $$)
+   * and return what follows it
+   */
+
+  if (*++action == '<') {
+    while (*action && *action++ != '>') {
+      ;
+    }
+  }
+
+  if (*action == '$') {
+    *num = 0;
+    return action + 1;
+  }
+
+  *num = atoi(action);
+  if (*action == '-') {
+    ++action;
+  }
+  while (isdigit(*action)) {
+    ++action;
+  }
+  return action;
+}
+
+static void dollar_use(PRODUCTION *prod, char *action, int rhs_size)
+{
+  /* set prod->sets_val if the action starts with $$ = (after the '{', and
+   * any comments), and $$ isn't read again before the end of that statement
+   * ($$ = $$ + 1 needs the copy), so the driver needn't copy $1 into $$
+   * first. set
+   * prod->in_place if $1 isn't used at all: $$ can then be $1's own place
+   * on the value stack, which holds $1 until the action changes it (see
+   * Yy_needs[] in yystate.c). an action that gets at the value stack
+   * itself (yyvsp, Yy_vsp or Yy_val) is left alone.
+   */
+
+  static char *names[] = { "yyvsp", "Yy_vsp", "Yy_val", NULL };
+  char *p = action, **np, *start;
+  int num, len, depth;
+
+  while (isspace(*p) || *p == '{' || (*p == '/' && (p[1] == '*' || p[1] == '/'))) {
+    if (*p != '/') {
+      ++p;
+    } else if (p[1] == '/') {
+      p += strcspn(p, "\n");
+    } else {
+      p = (p = strstr(p + 2, "*/")) ? p + 2 : "";
+    }
+  }
+  if (*p == '$') {
+    p = skip_dollar(p, &num);
+    p += strspn(p, " \t\r\n");
+    prod->sets_val = (num == 0 && p[0] == '=' && p[1] != '=');
+
+    for (depth = 0, ++p; prod->sets_val && *p && (*p != ';' || depth); ) {
+      if (*p == '"' || *p == '\'') {       /* skip a string or character constant */
+        for (start = p++; *p && *p != *start; ++p) {
+          if (*p == '\\' && p[1]) {
+            ++p;
+          }
+        }
+        p += (*p != '\0');
+      } else if (*p == '$') {
+        p = skip_dollar(p, &num);
+        prod->sets_val = (num != 0);
+      } else {
+        depth += (*p == '(' || *p == '{') - (*p == ')' || *p == '}');
+        ++p;
+      }
+    }
+  }
+
+  prod->in_place = rhs_size > 0;
+  for (p = action; *p && prod->in_place; ) {
+    if (*p == '$') {
+      p = skip_dollar(p, &num);
+      prod->in_place = (num != 1);
+    } else if (isalpha(*p) || *p == '_') {
+      for (start = p; isalnum(*p) || *p == '_'; ++p) {
+        ;
+      }
+      len = p - start;
+      for (np = names; *np; ++np) {
+        if (len == strlen(*np) && !strncmp(start, *np, len)) {
+          prod->in_place = 0;
+        }
+      }
+    } else {
+      ++p;
+    }
+  }
+}
+
+static void print_one_case(int case_val, char *action, int rhs_size, int lineno, PRODUCTION *prod, int in_place)
 {
   /* case_val: numeric value attached to case itself
    * action:  source code to execute in case
    * rhs_size: number of symbols on right-hand side
    * lineno: input line number (for #lines)
    * prod: pointer to right-hand side
+   * in_place: $$ goes in $1's place on the value stack, not in Yy_val
    */
 
   /* print out one action as a case statement. all $-specifiers are mapped
@@ -106,7 +240,7 @@ static void print_one_case(int case_val, char *action, int rhs_size, int lineno,
         }
       }
 
-      output("%s", do_dollar(num, rhs_size, lineno, prod, fname));
+      output("%s", do_dollar(num, rhs_size, lineno, prod, fname, in_place));
     }
   }
   output("\n  break;\n");
@@ -151,11 +285,16 @@ static void dopatch(SYMBOL *sym)
     cur = *pp;
     
     if (ISACT(cur)) { /* check rightmost symbol */
-      print_one_case(prod->num, cur->string, --(prod->rhs_len), cur->lineno, prod);
+      prod->has_action = 1;
+      prod->uses_text = uses_text(cur->string);
+      dollar_use(prod, cur->string, --(prod->rhs_len));
+      print_one_case(prod->num, cur->string, prod->rhs_len, cur->lineno, prod, prod->in_place);
       delsym(Symtab, cur);
-      free(cur->string);
+      mem_free(cur->string);
       freesym(cur);
       *pp-- = NULL;
+    } else {
+      prod->in_place = 1; /* $$ = $1 is already on the stack */
     }
 
     /* cur is no longer valid because of the --pp above 
@@ -169,34 +308,35 @@ static void dopatch(SYMBOL *sym)
         continue;
       }
 
-      if (Cur_nonterm >= MAXNONTERM) {
-        error(FATAL, "too many nonterminals & actions (%d max)\n", MAXNONTERM);
-      } else {
-        /* transform the action into a nonterminal */
-        Terms[cur->val = ++Cur_nonterm] = cur;
-        cur->productions = (PRODUCTION *) malloc (sizeof(PRODUCTION));
-        if (!cur->productions) {
-          error(FATAL, "dopatch out of memory\n");
-        }
-        print_one_case(Num_productions, cur->string, pp - prod->rhs, cur->lineno, prod);
-
-        /* once the case is printed, the string argument can be freed*/
-
-        free(cur->string);
-        cur->string = NULL;
-        cur->productions->num = Num_productions++;
-        cur->productions->lhs = cur;
-        cur->productions->rhs_len = 0;
-        cur->productions->rhs[0] = NULL;
-        cur->productions->next = NULL;
-        cur->productions->prec = 0;
-
-        /* since the new production goes to epsilon and nothing else,
-         * FIRST(new) == {epsilon}
-         */
-        cur->first = newset();
-        ADD(cur->first, EPSILON);
+      /* transform the action into a nonterminal */
+      cur->kind = SYM_NONTERM;
+      set_val(cur, ++Cur_nonterm);
+      cur->productions = (PRODUCTION *) mem_calloc(MEM_PRODS, 1, sizeof(PRODUCTION));
+      if (!cur->productions || !(cur->productions->rhs = (SYMBOL **) mem_calloc(MEM_PRODS, 1, sizeof(SYMBOL *)))) {
+        error(FATAL, "dopatch out of memory\n");
       }
+      cur->productions->has_action = 1;
+      cur->productions->uses_text = uses_text(cur->string);
+      dollar_use(cur->productions, cur->string, 0);
+      print_one_case(Num_productions, cur->string, pp - prod->rhs, cur->lineno, prod, 0);
+
+      /* once the case is printed, the string argument can be freed*/
+
+      mem_free(cur->string);
+      cur->string = NULL;
+      cur->productions->num = Num_productions++;
+      cur->productions->lhs = cur;
+      cur->productions->rhs_len = 0;
+      cur->productions->rhs_max = 1;
+      cur->productions->rhs[0] = NULL;
+      cur->productions->next = NULL;
+      cur->productions->prec = 0;
+
+      /* since the new production goes to epsilon and nothing else,
+       * FIRST(new) == {epsilon}
+       */
+      cur->first = newset();
+      ADD(cur->first, EPSILON);
     }
   }
 }
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <set.h>
+#include <hash.h>
+#include <compiler.h>
+#include "parser.h"
+
+/*
+ * yyprof.c: the profile read by --profile=<file>.
+ *
+ * a parser compiled with -DYYPROFILE counts what it does, and yyprofile()
+ * (in rbison.par) prints the counts. given that output, make_parse_tables()
+ * (yystate.c) renumbers the states so that the busiest ones come first,
+ * and puts the pairs in each row in the order of how often they're looked
+ * up. the tables stay equivalent, only the order changes.
+ *
+ * the profile always uses the state numbers that rbison gave the states
+ * before any renumbering (Yy_natural[] maps them back in the parser), so a
+ * parser made with a profile can be profiled again. the lines that are used
+ * are:
+ *
+ *      # yyprofile: <states> states, <productions> productions
+ *      grammar <fingerprint>
+ *      state   <state> <visits> <shifts> <gotos>
+ *      action  <state> <token> <lookups>
+ *      goto    <state> <nonterminal> <lookups>
+ *
+ * the others (the prod lines, for one) are ignored. a profile that was
+ * made for another grammar (the fingerprint is the one that -c uses, see
+ * yycache.c) is ignored with a warning, and so is one that can't be read.
+ */
+
+typedef struct _count_ {
+  int kind;                   /* 'a' (action) or 'g' (goto) */
+  int state;
+  int sym;                    /* token, or adjusted nonterminal */
+  long n;
+} COUNT;
+
+static long *States = NULL;   /* visits + gotos, indexed by state */
+static int Nstates = 0;
+static COUNT *Counts = NULL;  /* sorted by count_cmp() */
+static int Ncounts = 0;
+static int Max_counts = 0;
+
+static int count_cmp(const void *p1, const void *p2)
+{
+  const COUNT *c1 = (const COUNT *) p1, *c2 = (const COUNT *) p2;
+
+  if (c1->kind != c2->kind) {
+    return c1->kind - c2->kind;
+  }
+  if (c1->state != c2->state) {
+    return c1->state - c2->state;
+  }
+  return c1->sym - c2->sym;
+}
+
+static void add_count(int kind, int state, int sym, long n)
+{
+  if (Ncounts >= Max_counts) {
+    Max_counts = Max_counts ? Max_counts * 2 : 256;
+    if (!(Counts = (COUNT *) mem_realloc(MEM_OUTPUT, Counts, Max_counts * sizeof(COUNT)))) {
+      error(FATAL, "no memory for profile %s\n", Profile_file);
+    }
+  }
+  Counts[Ncounts].kind  = kind;
+  Counts[Ncounts].state = state;
+  Counts[Ncounts].sym   = sym;
+  Counts[Ncounts++].n   = n;
+}
+
+static long find_count(int kind, int state, int sym)
+{
+  COUNT key, *p;
+
+  key.kind  = kind;
+  key.state = state;
+  key.sym   = sym;
+  p = (COUNT *) bsearch(&key, Counts, Ncounts, sizeof(COUNT), count_cmp);
+  return p ? p->n : 0;
+}
+
+static void unload()
+{
+  mem_free(States);
+  mem_free(Counts);
+  States = NULL;
+  Counts = NULL;
+  Ncounts = Max_counts = Nstates = 0;
+}
+
+int prof_load(int nstates)
+{
+  /* read Profile_file, for tables with nstates states. return 1 if it was
+   * read and it was made for the current grammar, 0 otherwise (the prof_
+   * functions then return 0 for everything).
+   */
+
+  char line[256], fp_now[32], fp_prof[32];
+  FILE *fp;
+  int s, sym, np, matched = 0;
+  long n, visits, shifts, gotos;
+
+  if (!Profile_file) {
+    return 0;
+  }
+
+  if (!(fp = fopen(Profile_file, "r"))) {
+    error(WARNING, "can't open profile %s, ignoring it\n", Profile_file);
+    return 0;
+  }
+
+  if (!(States = (long *) mem_calloc(MEM_OUTPUT, nstates, sizeof(long)))) {
+    error(FATAL, "no memory for profile %s\n", Profile_file);
+  }
+  Nstates = nstates;
+
+  sprintf(fp_now, "%016llx", grammar_fingerprint());
+  *fp_prof = '\0';
+
+  while (fgets(line, sizeof(line), fp)) {
+    if (!strchr(line, '\n') && !feof(fp)) {   /* a long prod line, skip the rest */
+      while ((s = getc(fp)) != EOF && s != '\n') {
+        ;
+      }
+    }
+
+    if (sscanf(line, "# yyprofile: %d states, %d productions", &s, &np) == 2) {
+      matched = (s == nstates && np == Num_productions);
+    } else if (sscanf(line, "grammar %31s", fp_prof) == 1) {
+      ;
+    } else if (sscanf(line, "state %d %ld %ld %ld", &s, &visits, &shifts, &gotos) == 4) {
+      if (s >= 0 && s < nstates) {
+        States[s] = visits + gotos;
+      }
+    } else if (sscanf(line, "action %d %d %ld", &s, &sym, &n) == 3) {
+      add_count('a', s, sym, n);
+    } else if (sscanf(line, "goto %d %d %ld", &s, &sym, &n) == 3) {
+      add_count('g', s, sym, n);
+    }
+  }
+  fclose(fp);
+
+  if (!matched || strcmp(fp_prof, fp_now)) {
+    error(WARNING, "profile %s was made for a different grammar, ignoring it\n", Profile_file);
+    unload();
+    return 0;
+  }
+
+  qsort(Counts, Ncounts, sizeof(COUNT), count_cmp);
+  return 1;
+}
+
+long prof_state(int state)
+{
+  /* how often state was visited, or was uncovered by a reduction */
+
+  return (States && state >= 0 && state < Nstates) ? States[state] : 0;
+}
+
+long prof_action(int state, int token)
+{
+  /* how often the action for token was looked up in state */
+
+  return Counts ? find_count('a', state, token) : 0;
+}
+
+long prof_goto(int state, int nonterm)
+{
+  /* how often the goto on (adjusted) nonterm was looked up in state */
+
+  return Counts ? find_count('g', state, nonterm) : 0;
+}
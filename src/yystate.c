@@ -1,6 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
+#include <sys/sysinfo.h>
+#include <pthread.h>
 #include <set.h>
 #include <hash.h>
 #include <compiler.h>
@@ -8,114 +11,430 @@
 #include "llout.h"  /* for _EOI_ definition */
 
 /* for statistics only: */
-static int Nitems         = 0;  /* number of LALR(1) items */
+static int Nitems         = 0;  /* number of LALR(1) items kept in states */
 static int Npairs         = 0;  /* # of pairs in output tables */
-static int Ntab_entries   = 0;  /* number of transitions in tables */
+static int Nrows          = 0;  /* # of row arrays in output tables */
 static int Shift_reduce   = 0;  /* number of shift/reduce conflicts */
 static int Reduce_reduce  = 0;  /* number of reduce/reduce conflicts */ 
 
 
-#define MAXSTATE 512  /* max # of LALR(1) states */
 #define MAXOBUF 256   /* buffer size for various output routines */
 
 typedef struct _item_ {   /* LALR(1) item */
-  int prod_num;           /* production number */
-  PRODUCTION *prod;       /* the production itself */
-  SYMBOL *right_of_dot;   /* symbol to the right of the dot */
-  unsigned int dot_posn;  /* offset of dot form start of production */
-  SET *lookaheads;        /* set of lookahead symbol for this item */
+  int id;                 /* the LR(0) item, see below */
+  SET *lookaheads;        /* set of lookahead symbol for this item, interned */
 } ITEM;
 
-#define RIGHT_OF_DOT(p) ((p)->right_of_dot ? (p)->right_of_dot->val : 0)
+/* every LR(0) item (a production with a dot somewhere in it) has a number,
+ * its id. the ids of production n run from Prod_base[n] (dot at the far
+ * left) to Prod_base[n] + rhs_len (dot at the far right), and the productions
+ * are numbered in order, so comparing ids compares production numbers and
+ * then dot positions. moving the dot is ++id. everything else about an item
+ * is looked up in the tables made by make_ids().
+ */
+
+static int *Prod_base;          /* indexed by production number */
+static PRODUCTION **Id_prod;    /* the rest are indexed by id: the production */
+static SYMBOL **Id_sym;         /* symbol to the right of the dot, NULL if none */
+static int *Id_key;             /* value of that symbol, 0 if none */
+static int Nids;
+static int Max_key;             /* largest Id_key[] */
 
-#define MAXKERNEL   32      /* maximum number of kernel items in a state */
-#define MAXCLOSE    128     /* maximum number of closure items in a state (less the epsilon productions)*/
-#define MAXEPSILON  8       /* maximum number of epsilon productions that can be in a closure set for any given state */
+#define ITEM_PROD(p)    (Id_prod[(p)->id])
+#define DOT_POSN(p)     ((p)->id - Prod_base[ITEM_PROD(p)->num])
+#define NEXT_SYM(p)     (Id_sym[(p)->id])
+#define RIGHT_OF_DOT(p) (Id_key[(p)->id])
 
 typedef struct _state {   /* LALR(1) state */
-  ITEM *kernel_items[MAXKERNEL];    /* set of kernel items */
-  ITEM *epsilon_items[MAXEPSILON];  /* set of epsilon items */
+  ITEM **kernel_items;    /* set of kernel items (allocated with the STATE) */
+  int *kernel;            /* their ids, in increasing order (ditto) */
+  ITEM **epsilon_items;   /* set of epsilon items */
 
   unsigned int nkitems;  /* items in kernel_items[] */
   unsigned int neitems;  /* items in epsilon_items[] */
   unsigned int closed;   /* state has had closure performed */
 
   unsigned int num;      /* state number (0 is start state) */
+  unsigned int hash;     /* kernel_hash() of the kernel items */
 } STATE;
 
 
 typedef struct act_or_goto {
   int sym;                    /* given this input symbol */
   int do_this;                /* do this. >0 == shift <0 == reduce */
-  struct act_or_goto *next;   /* pointer to next ACT in the linked list */ 
 } ACT;
 
 
 typedef ACT GOTO;   /* GOTO is an alias for ACT */
 
-static ACT *Actions[MAXSTATE]; /* array of pointers to the head of the action chains. 
-                                * indexed by state number. i'm counting on initialization 
-                                * to NULL here.
-                                */
+typedef struct _row_ {        /* the actions (or gotos) of one state */
+  ACT *acts;                  /* in the order in which they were added */
+  int nacts;
+  int maxacts;                /* size of acts */
+  int *col;                   /* col[sym] is 1 + the index in acts of the ACT
+                               * for sym, 0 if there isn't one. NULL if the
+                               * row has no more than ROW_SCAN ACTs, which
+                               * are searched instead, or if it's been freed
+                               * (see free_cols()).
+                               */
+} ROW;
+
+#define ROW_SCAN 16   /* the most ACTs in a row without a col index */
+
+/* the rows are indexed by state number. the rows of Actions are indexed by
+ * terminal, those of Gotos by ADJ_VAL(nonterminal). new rows are empty (see
+ * grow_states()). the ACTs of a row are printed in the reverse of the order
+ * in which they were added.
+ */
 
-static GOTO *Gotos[MAXSTATE];  /* array of pointers to the head of the goto chains */
+static ROW *Actions = NULL;
+static ROW *Gotos = NULL;
 
+#define ACTION_COLS (max(Cur_term, WHITESPACE) + 1)  /* WHITESPACE can be a lookahead */
+#define GOTO_COLS   USED_NONTERMS
 
 
-#define CHUNK 128                 /* New gets this many structures at once */
-static HASH_TAB *States = NULL;   /* LALR(1) states */
-static int Nstates = 0;           /* number of states */
+typedef struct _conflict_ {   /* a conflict found by reduce_one_item() */
+  int state;                  /* in this state */
+  int token;                  /* on this lookahead */
+  int prod;                   /* reducing by this production */
+  int other;                  /* r/r: production already in the table. s/r: -1 */
+  int choice;                 /* r/r: production chosen. s/r: resulting action */
+  int resolved;               /* s/r: resolved by precedence */
+} CONFLICT;
 
-#define MAX_UNFINISHED 128
+typedef struct _conflict_log_ {
+  CONFLICT *conflicts;
+  int nconflicts;
+  int maxconflicts;
+} CONFLICT_LOG;
 
-typedef struct tnode {
-  STATE *state;
-  struct tnode *left, *right;
-} TNODE;
+static CONFLICT_LOG Conflicts;    /* every conflict that was reported, in order,
+                                   * so that they can be cached and replayed
+                                   */
+
+/* set when the tables were ordered by a profile (--profile, see yyprof.c) */
+static int Profiled = 0;
+static int *Natural = NULL;       /* Natural[n]: what state n was numbered before that */
+
+static int Nact = 0;              /* # of productions that have actions */
+static int Ntext = 0;             /* # of them whose actions use yytext */
+static int Nplace = 0;            /* # of productions whose $$ is made in place */
 
+#define NEED_ACT  1               /* the bits in Yy_needs[], see make_yy_needs() */
+#define NEED_TEXT 2
+#define NO_COPY   4
+#define IN_PLACE  8
 
-static TNODE Heap[MAX_UNFINISHED];  /* source of all TNODEs */
-static TNODE *Next_allocate = Heap; /* ptr to next node to allocate */
 
-static TNODE *Available = NULL;     /* free list of available nodes 
-                                     * linked list of TNODEs. p->left is used
-                                     * as the link
-                                     */
 
-static TNODE *Unfinished = NULL; /* tree of unfinished states */
+#define MAXTHREADS 256            /* most threads used with -j */
+static HASH_TAB *States = NULL;   /* LALR(1) states */
+static STATE **Statev = NULL;     /* the same states, indexed by number */
+static int Nstates = 0;           /* number of states */
+static int Max_states = 0;        /* size of Statev, Actions and Gotos */
+
+/* the unfinished states. Pending has a bit set for the number of each one,
+ * so a state is never on the list twice. -q sets the order in which they're
+ * worked on (Work_order in parser.h):
+ *
+ *      n  lowest state number first. Pending is scanned upwards from Low,
+ *         which is never larger than the smallest pending number.
+ *      f  first in, first out. Work is a ring buffer of the states, in
+ *      l  last in, first out.   the order in which they were added.
+ *
+ * states are numbered as they're made, so n and f number them the same way
+ * and l numbers them differently. the tables are equivalent.
+ */
+
+static SET *Pending = NULL;
+static int Npending = 0;      /* # of bits set in Pending */
+static int Low = 0;
+static STATE **Work = NULL;   /* Work[Work_head] is the oldest state */
+static int Work_head = 0;
+static int Work_max = 0;      /* size of Work */
 
-static ITEM **State_items;      /* used to pass info to state_cmp */
+static int Max_pending = 0;   /* for statistics: most states pending at once */
+static int Nrevisits = 0;     /* # of times a closed state was worked on again */
+
+static int *State_ids;          /* used to pass info to state_cmp */
 static int State_nitems;
-static int Sort_by_number;
+static int Max_ids = 0;         /* size of State_ids */
+static unsigned int State_hash; /* and state_hash */
 
 #define NEW 0       /* possible return values from newstate() */
 #define UNCLOSED 1  
 #define CLOSED 2
 
-ITEM *Recycled_items = NULL;
+/* items are carved out of arenas. the items that belong to a state (kernel
+ * and epsilon items) live in Items and are never freed. the items made while
+ * a state is being closed live in the scratch arena of the WORKER that closes
+ * it, which is emptied before the worker starts on the next state (or the
+ * next batch of states, see lr()), so that closure items aren't freed one at
+ * a time.
+ *
+ * the lookahead sets are interned (see intern() in set.c): an item points at
+ * the one shared copy of its set, so most items share a handful of sets and
+ * equal sets can be recognized by pointer. the shared sets are never changed.
+ * adding lookaheads to an item points it at a different set (la_union()).
+ */
+
+#define ARENA_ALIGN 16
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+#define ITEMS_PER_BLOCK 256
+#define ITEM_SIZE ARENA_ROUND(sizeof(ITEM))
+
+typedef struct _block_ {
+  struct _block_ *next;       /* next block in the arena */
+} BLOCK;
+
+typedef struct _arena_ {
+  BLOCK *first;               /* all blocks, oldest first */
+  BLOCK *cur;                 /* block that's being carved up */
+  char *next;                 /* next free byte in cur */
+  char *end;                  /* end of cur */
+  long size;                  /* bytes allocated for all blocks */
+  int reusing;                /* cur was emptied by arena_reset() */
+  long made;                  /* statistics: # of items handed out */
+  long recycled;              /* # of them that reused memory */
+} ARENA;
+
+static ARENA Items;           /* items owned by states */
+static SET *No_lookaheads;    /* the interned empty set */
+
+/* with -j, several threads work on different states at the same time (see
+ * parallel_for()). everything that a thread changes while it does that is in
+ * its WORKER. Workers[0] is also used by the code that runs in one thread
+ * only.
+ */
+
+typedef struct _worker_ {
+  pthread_t thread;
+  ARENA scratch;              /* closure items */
+  SET *closure_set;           /* FIRST(de) in do_close() */
+  SET *union_set;             /* scratch set for la_union() */
+  int *count;                 /* for sort_items(), indexed by RIGHT_OF_DOT() + 1 */
+  ITEM **sorted;              /* ditto */
+  int maxsorted;              /* size of sorted */
+  int interning;              /* holds Intern_lock */
+
+  int nentries;               /* # of ACTs and GOTOs made */
+
+  long nclosures;             /* for --stats: # of closure() calls */
+  long ndo_close;             /* # of do_close() calls */
+  long nmerges;               /* # of lookahead sets merged into others */
+  long nchanged;              /* # of those merges that added something */
+  long nset_tests;            /* # of subset() and IS_EMPTY() calls */
+  long nset_ops;              /* # of UNION(), ASSIGN(), CLEAR() and first_rhs() calls */
+
+  CONFLICT_LOG log;           /* conflicts found by reduce_one_item(), in state order */
+  int reported;               /* # of them moved to Conflicts by report_state() */
+} WORKER;
+
+static WORKER *Workers = NULL;
+static int Nworkers = 0;
+
+/* intern() isn't reentrant */
+static pthread_mutex_t Intern_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* the loop that parallel_for() runs */
+static void (*Par_body)(WORKER *w, int i);
+static int Par_n;             /* body is called for i = 0..Par_n-1 */
+static int Par_next;          /* first i of the next chunk to be handed out */
+static int Par_chunk;         /* # of i's handed out at once */
+static int Par_threads = 0;   /* # of threads running it, 0 outside parallel_for() */
+static int Par_failed = 0;    /* one of them got a fatal error */
+static __thread WORKER *Par_self = NULL;  /* the WORKER of this thread in parallel_for() */
+static pthread_mutex_t Par_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *par_thread(void *arg)
+{
+  /* thread function: run chunks of the parallel_for() loop until there are
+   * none left. the chunks are handed out in order, so each thread sees i
+   * increasing.
+   */
+
+  WORKER *w = (WORKER *) arg;
+  int i, end;
+
+  Par_self = w;
+  for (;;) {
+    pthread_mutex_lock(&Par_lock);
+    i = Par_next;
+    Par_next += Par_chunk;
+    pthread_mutex_unlock(&Par_lock);
+
+    if (i >= Par_n) {
+      return NULL;
+    }
+    for (end = min(i + Par_chunk, Par_n); i < end; ++i) {
+      (*Par_body)(w, i);
+    }
+  }
+}
+
+static void par_join()
+{
+  /* wait for the other threads of parallel_for() to finish */
+
+  int i;
+
+  for (i = 1; i < Par_threads; ++i) {
+    pthread_join(Workers[i].thread, NULL);
+  }
+  Par_threads = 0;
+  Par_self = NULL;
+}
+
+static void parallel_for(int n, int chunk, void (*body)(WORKER *w, int i))
+{
+  /* call body(w, i) for i = 0..n-1 using up to Nworkers threads, where w is
+   * the WORKER of the thread that makes the call. the i's are handed out
+   * chunk at a time, so a thread that gets cheap ones just takes more.
+   * returns when all of the calls have returned.
+   */
+
+  int nthreads;
+
+  Par_body  = body;
+  Par_n     = n;
+  Par_next  = 0;
+  Par_chunk = chunk;
+  Par_failed = 0;
+
+  Par_self = Workers;
+  Par_threads = 1;
+  nthreads = min(Nworkers, (n + chunk - 1) / chunk);
+  for (; Par_threads < nthreads; ++Par_threads) {
+    if (pthread_create(&Workers[Par_threads].thread, NULL, par_thread, &Workers[Par_threads]) != 0) {
+      error(FATAL, "can't create thread\n");
+    }
+  }
+
+  par_thread(&Workers[0]);  /* this thread does its share too */
+  par_join();
+
+  if (Par_failed) {         /* another thread stopped, see lr_fatal() */
+    give_up();
+  }
+}
+
+void lr_fatal()
+{
+  /* called by give_up() (main.c) after a fatal error. on one of the threads
+   * of parallel_for(), no more work is handed out and the thread stops. the
+   * one that called parallel_for() waits for the others first and then goes
+   * on giving up, they just end: parallel_for() gives up for them once they
+   * have all been joined. so On_fatal (or exit()) only ever runs on the
+   * thread that started the build, when no other thread is using its memory.
+   */
+
+  WORKER *w = Par_self;
+
+  if (!w) {                 /* not in parallel_for() */
+    return;
+  }
+
+  if (w->interning) {       /* intern() gave up, let the others at it */
+    w->interning = 0;
+    pthread_mutex_unlock(&Intern_lock);
+  }
+
+  pthread_mutex_lock(&Par_lock);
+  Par_next = Par_n;
+  pthread_mutex_unlock(&Par_lock);
+
+  if (w != Workers) {
+    Par_failed = 1;
+    pthread_exit(NULL);
+  }
+  par_join();
+}
 
 #define MAX_TOK_PER_LINE 15
 static int Tokens_printed; /* controls number of lookaheads printed on a single line of y.output */
 
 
-static void *new(void) 
+static ACT *row_find(ROW *row, int sym)
+{
+  /* return the ACT for sym in the row, NULL if there isn't one */
+
+  ACT *p, *end;
+
+  if (row->col) {
+    return row->col[sym] ? &row->acts[row->col[sym] - 1] : NULL;
+  }
+
+  for (p = row->acts, end = p + row->nacts; p < end; ++p) {
+    if (p->sym == sym) {
+      return p;
+    }
+  }
+  return NULL;
+}
+
+static ACT *row_add(WORKER *w, ROW *row, int ncols, int sym, int do_this)
 {
-  /* return an area of memory that can be used as either an ACT or GOTO.
-   * these objects cannot be freed
+  /* add an ACT for sym, which isn't in the row yet, and return it. ncols is
+   * the number of columns in the table. only the thread that works on the
+   * row's state changes it.
    */
-  
-  static ACT *eheap; /* assuming default initialization to NULL here */
-  static ACT *heap;  /* ditto */
 
-  if (heap >= eheap) { 
-    if (!(heap = (ACT *) malloc(sizeof(ACT) * CHUNK))) {
+  ACT *p;
+  int k;
+
+  if (row->nacts >= row->maxacts) {
+    row->maxacts = max(row->maxacts * 2, 8);
+    if (!(row->acts = (ACT *) mem_realloc(MEM_TABLES, row->acts, row->maxacts * sizeof(ACT)))) {
       error(FATAL, "no memory for action or goto\n");
     }
-    eheap = heap + CHUNK;
   }
-  
-  ++Ntab_entries;
-  return heap++;
+
+  ++w->nentries;
+  p = &row->acts[row->nacts++];
+  p->sym = sym;
+  p->do_this = do_this;
+
+  if (row->col) {
+    row->col[sym] = row->nacts;
+  } else if (row->nacts > ROW_SCAN) {   /* too long to search, index it */
+    if (!(row->col = (int *) mem_calloc(MEM_TABLES, ncols, sizeof(int)))) {
+      error(FATAL, "no memory for action or goto\n");
+    }
+    for (k = 0; k < row->nacts; ++k) {
+      row->col[row->acts[k].sym] = k + 1;
+    }
+  }
+  return p;
+}
+
+static void free_cols()
+{
+  /* free the col indexes once the tables are finished. they're only used
+   * to find the ACT for a symbol while the tables are made, and they take
+   * more memory than the ACTs themselves. row_find() still works, it
+   * searches the row.
+   */
+
+  int i;
+
+  for (i = 0; i < Nstates; ++i) {
+    mem_free(Actions[i].col);
+    mem_free(Gotos[i].col);
+    Actions[i].col = Gotos[i].col = NULL;
+  }
+}
+
+static int tab_entries()
+{
+  /* return the number of transitions in the tables */
+
+  int i, n = 0;
+
+  for (i = 0; i < Nworkers; ++i) {
+    n += Workers[i].nentries;
+  }
+  return n;
 }
 
 
@@ -126,29 +445,21 @@ static ACT *p_action(int state, int input_sym)
    * state and input symbol (or NULL if no such symbol exists).
    */
   
-  ACT *p;
-
-  if (state >= MAXSTATE) {
+  if (state >= Nstates) {
     error(FATAL, "bad state argument to p_action (%d)\n", state);
   }
 
-  for (p = Actions[state]; p; p = p->next) {
-    if (p->sym == input_sym) {
-      return p;
-    }
-  }
-
-  return NULL;
+  return row_find(&Actions[state], input_sym);
 }
 
-static void add_action(int state, int input_sym, int do_this)
+static void add_action(WORKER *w, int state, int input_sym, int do_this)
 {
   /* add an element to the action part of the parse table. the cell is
    * indexed by the state number and input symbol, and holds do_this.
    */
 
   ACT *p;
-  if (state > MAXSTATE) {
+  if (state >= Nstates) {
     error(FATAL, "bad state argument to add_action (%d)\n", state);
   }
 
@@ -164,11 +475,7 @@ static void add_action(int state, int input_sym, int do_this)
             state, do_this, Terms[input_sym]->name);
   }
 
-  p = (ACT *) new();
-  p->sym = input_sym;
-  p->do_this = do_this;
-  p->next = Actions[state];
-  Actions[state] = p;
+  row_add(w, &Actions[state], ACTION_COLS, input_sym, do_this);
 }
 
 
@@ -181,28 +488,21 @@ static GOTO *p_goto(int state, int nonterminal)
    * before doing the table look up, however.
    */
   
-  GOTO *p;
   int unadjusted = nonterminal;   /* original value of nonterminal */
 
-  if (state > MAXSTATE) {
+  if (state >= Nstates) {
     error(FATAL, "bad state argument to p_goto (%d)\n", state);
   }
 
   nonterminal = ADJ_VAL(nonterminal);
-  if (nonterminal >= NUMNONTERMS) {
+  if (nonterminal < 0 || unadjusted > Cur_nonterm) {
     error(FATAL, "bad nonterminal argument to p_goto (%d)\n", unadjusted);
   }
 
-  for (p = Gotos[state]; p; p = p->next) {
-    if (p->sym == nonterminal) {
-      return p;
-    }
-  }
-
-  return NULL;
+  return row_find(&Gotos[state], nonterminal);
 }
 
-static void add_goto(int state, int nonterminal, int go_here)
+static void add_goto(WORKER *w, int state, int nonterminal, int go_here)
 {
   /* add an element to the goto part of the parse table, the cell is indexed
    * by current state number and nonterminal value, and holds go_here. note
@@ -215,11 +515,11 @@ static void add_goto(int state, int nonterminal, int go_here)
   int unadjusted = nonterminal;   /* original value of nonterminal */
   nonterminal = ADJ_VAL(nonterminal);
 
-  if (state > MAXSTATE) {
+  if (state >= Nstates) {
     error(FATAL, "bad state argument to add_goto (%d)\n", state);
   }
 
-  if (nonterminal >= NUMNONTERMS) {
+  if (nonterminal < 0 || unadjusted > Cur_nonterm) {
     error(FATAL, "bad nonterminal argument to add_goto (%d)\n", unadjusted);
   }
 
@@ -236,11 +536,7 @@ static void add_goto(int state, int nonterminal, int go_here)
               state, go_here, Terms[unadjusted]->name);
   }
 
-  p = (GOTO *) new();
-  p->sym = nonterminal;
-  p->do_this = go_here;
-  p->next = Gotos[state];
-  Gotos[state] = p;
+  row_add(w, &Gotos[state], GOTO_COLS, nonterminal, go_here);
 }
 
 static void sprint_tok(char **bp, char *format, int arg)
@@ -269,43 +565,55 @@ static void sprint_tok(char **bp, char *format, int arg)
   }
 }
 
+static char *Item_buf = NULL;   /* stritem()'s string */
+static int Item_size = 0;
+
 static char *stritem(ITEM *item, int lookaheads)
 {
   /* return a pointer to a string that holds a representation of an item.
    * The lookaheads are printed too if "lookaheads" is true or Verbose
    * is > 1 (-V was specified on the command line).
    */
-  static char buf[MAXOBUF * 4];
-  char *bp;
-  int i;
+  char *buf, *bp;
+  int i, need;
+  PRODUCTION *prod = ITEM_PROD(item);
 
-  bp = buf;
-  bp += sprintf(bp, "%s->", item->prod->lhs->name);
+  /* each symbol takes at most MAXNAME + 8 characters, including the line
+   * breaks in the lookaheads
+   */
+
+  need = MAXOBUF + (prod->rhs_len + num_ele(item->lookaheads)) * (MAXNAME + 8);
+  if (need > Item_size && !(Item_buf = (char *) mem_realloc(MEM_OUTPUT, Item_buf, Item_size = need))) {
+    error(FATAL, "no memory for stritem\n");
+  }
+
+  bp = buf = Item_buf;
+  bp += sprintf(bp, "%s->", prod->lhs->name);
 
-  if (item->prod->rhs_len <= 0) {
+  if (prod->rhs_len <= 0) {
     bp += sprintf(bp, "<epsilon>. ");
   } else {
-    for (i = 0; i < item->prod->rhs_len; i++) {
-      if (i == item->dot_posn) {
+    for (i = 0; i < prod->rhs_len; i++) {
+      if (i == DOT_POSN(item)) {
         *bp++ = '.';
       }
 
-      bp += sprintf(bp, " %s", item->prod->rhs[i]->name);
+      bp += sprintf(bp, " %s", prod->rhs[i]->name);
     }
 
-    if (i == item->dot_posn) {
+    if (i == DOT_POSN(item)) {
       *bp++ = '.';
     }
   }
 
   if (lookaheads || Verbose > 1) {
-    bp += sprintf(bp, " (production %d, precedence %d)\n    [", item->prod_num, item->prod->prec);
+    bp += sprintf(bp, " (production %d, precedence %d)\n    [", prod->num, prod->prec);
     Tokens_printed = 0;
     pset(item->lookaheads, (pset_t)sprint_tok, &bp);
     *bp++ = ']';
   }
 
-  if (bp >= &buf[sizeof(buf)]) {
+  if (bp >= &buf[Item_size]) {
     error(FATAL, "stritem buffer overflow\n");
   }
 
@@ -327,7 +635,7 @@ static void pstate(STATE *state)
   /* print the kernel and epsilon items for the current state */
 
   for (i = state->nkitems, item = state->kernel_items; --i >= 0; ++item) {
-    document("  %s\n", stritem(*item, (*item)->right_of_dot == 0));
+    document("  %s\n", stritem(*item, !NEXT_SYM(*item)));
   }
 
   for (i = state->neitems, item = state->epsilon_items; --i >= 0; ++item) {
@@ -356,7 +664,7 @@ static void pstate(STATE *state)
     }
   }
 
-  for (i = MINNONTERM; i < MINNONTERM + USED_NONTERMS; i++) {
+  for (i = Min_nonterm; i <= Cur_nonterm; i++) {
     if (p = p_goto(state->num, i)) {
       document("  goto %d on %s\n", p->do_this, Terms[i]->name);
     }
@@ -384,17 +692,155 @@ static void pclosure(STATE *kernel, ITEM **closure_items, int nitems)
   }
 }
 
+static ITEM *arena_item(ARENA *arena)
+{
+  /* return an item with no lookaheads from the indicated arena.
+   * blocks that were emptied by arena_reset() are reused before new ones
+   * are allocated.
+   */
+
+  BLOCK *block;
+  ITEM *item;
+
+  if (arena->next + ITEM_SIZE > arena->end) {
+    arena->reusing = 1;
+    if (!(block = arena->cur ? arena->cur->next : arena->first)) {
+      if (!(block = (BLOCK *) mem_alloc(MEM_ITEMS, ARENA_ROUND(sizeof(BLOCK)) + ITEMS_PER_BLOCK * ITEM_SIZE))) {
+        error(FATAL, "no memory for LALR(1) items\n");
+      }
+      block->next = NULL;
+      *(arena->cur ? &arena->cur->next : &arena->first) = block;
+      arena->size += ARENA_ROUND(sizeof(BLOCK)) + ITEMS_PER_BLOCK * ITEM_SIZE;
+      arena->reusing = 0;
+    }
+
+    arena->cur = block;
+    arena->next = (char *) block + ARENA_ROUND(sizeof(BLOCK));
+    arena->end = arena->next + ITEMS_PER_BLOCK * ITEM_SIZE;
+  }
+
+  item = (ITEM *) arena->next;
+  arena->next += ITEM_SIZE;
+  ++arena->made;
+  arena->recycled += arena->reusing;
+  item->lookaheads = No_lookaheads;
+  return item;
+}
+
+static void arena_reset(ARENA *arena)
+{
+  /* empty the arena, keeping its blocks for the next arena_item() calls */
+
+  arena->cur = NULL;
+  arena->next = arena->end = NULL;
+}
+
+static ITEM *keepitem(ITEM *item)
+{
+  /* copy a scratch item into the arena of items that are owned by states */
+
+  ITEM *kept = arena_item(&Items);
+
+  ++Nitems;
+  kept->id = item->id;
+  kept->lookaheads = item->lookaheads;
+  return kept;
+}
+
+static SET *la_union(WORKER *w, SET *dst, SET *src)
+{
+  /* return the interned union of two lookahead sets. dst is interned and
+   * can't be changed, so the union is made in a scratch set.
+   */
+
+  SET *set;
+
+  w->nset_ops += 2;
+  ASSIGN(w->union_set, dst);
+  UNION(w->union_set, src);
+
+  pthread_mutex_lock(&Intern_lock);
+  w->interning = 1;
+  set = intern(w->union_set);
+  w->interning = 0;
+  pthread_mutex_unlock(&Intern_lock);
+  return set;
+}
+
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static unsigned int mix(unsigned int h, unsigned int k)
+{
+  /* add k to the running hash h (one round of MurmurHash3) */
+
+  k *= 0xcc9e2d51;
+  k = ROTL(k, 15);
+  k *= 0x1b873593;
+  h ^= k;
+  h = ROTL(h, 13);
+  return h * 5 + 0xe6546b64;
+}
+
+static unsigned int kernel_hash(int *ids, int nitems)
+{
+  /* hash the item ids of a kernel, in the order in which state_cmp()
+   * compares them. unlike a simple sum, the result depends on the order
+   * of the ids.
+   */
+
+  unsigned int h = nitems;
+
+  while (--nitems >= 0) {
+    h = mix(h, *ids++);
+  }
+
+  h ^= h >> 16;  /* final avalanche */
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  return h ^ (h >> 16);
+}
+
+static void grow_states(int n)
+{
+  /* make room in Statev, Actions and Gotos for at least n states. they're
+   * only changed while one thread is running.
+   */
+
+  int max = Max_states;
+
+  if (n <= max) {
+    return;
+  }
+
+  Max_states = max(n, max * 2);
+  if (!(Statev = (STATE **) mem_realloc(MEM_STATES, Statev, Max_states * sizeof(STATE *)))
+        || !(Actions = (ROW *) mem_realloc(MEM_TABLES, Actions, Max_states * sizeof(ROW)))
+        || !(Gotos = (ROW *) mem_realloc(MEM_TABLES, Gotos, Max_states * sizeof(ROW)))) {
+    error(FATAL, "no memory for LALR(1) states\n");
+  }
+  memset(Actions + max, 0, (Max_states - max) * sizeof(ROW));
+  memset(Gotos + max, 0, (Max_states - max) * sizeof(ROW));
+}
+
 int newstate(ITEM **items, int nitems, STATE **statep)
 {
   STATE *state;
+  int i;
   STATE *existing;
   
-  if (nitems > MAXKERNEL) {
-    error(FATAL, "kernel of new state %d too large\n", Nstates);
+  if (nitems > Max_ids) {
+    Max_ids = max(nitems, Max_ids * 2);
+    if (!(State_ids = (int *) mem_realloc(MEM_STATES, State_ids, Max_ids * sizeof(int)))) {
+      error(FATAL, "no memory for states\n");
+    }
   }
 
-  State_items = items;    /* set up parameters for state_cmp */
-  State_nitems = nitems;  /* and state_hash */
+  for (i = 0; i < nitems; ++i) {  /* set up parameters for state_cmp */
+    State_ids[i] = items[i]->id;  /* and state_hash */
+  }
+  State_nitems = nitems;
+  State_hash = kernel_hash(State_ids, nitems);
 
   if (existing = (STATE *) findsym(States, NULL)) {
     /* state exists; by not setting "state" to NULL, we'll recycle
@@ -409,19 +855,25 @@ int newstate(ITEM **items, int nitems, STATE **statep)
 
     return existing->closed ? CLOSED : UNCLOSED;
   } else {
-    if (Nstates >= MAXSTATE) {
-      error(FATAL, "too many LALR(1) states\n");
-    }
+    grow_states(Nstates + 1);
 
-    if (!(state = (STATE *) newsym(sizeof(STATE)))) {
+    if (!(state = (STATE *) newsym_in(MEM_STATES, sizeof(STATE) + nitems * (sizeof(ITEM *) + sizeof(int))))) {
       error(FATAL, "no memeory for states\n");
     }
 
-    memcpy(state->kernel_items, items, nitems * sizeof(ITEM*));
+    state->kernel_items = (ITEM **) (state + 1);
+    state->kernel = (int *) (state->kernel_items + nitems);
+    state->epsilon_items = NULL;
+    for (i = 0; i < nitems; ++i) {
+      state->kernel_items[i] = keepitem(items[i]);
+    }
+    memcpy(state->kernel, State_ids, nitems * sizeof(int));
     state->nkitems = nitems;
     state->neitems = 0;
     state->closed = 0;
+    state->hash = State_hash;
     state->num = Nstates++;
+    Statev[state->num] = state;
     *statep = state;
     addsym(States, state);
 
@@ -437,61 +889,75 @@ int newstate(ITEM **items, int nitems, STATE **statep)
 
 static void add_unfinished(STATE *state)
 {
-  TNODE **parent, *root;
-  int cmp;
+  /* add state to the unfinished list, unless it's already there */
 
-  parent = &Unfinished;
-  root = Unfinished;
-  while (root) { /* look for the node in the tree */
-    if ((cmp = state->num - root->state->num) == 0) {
-      break;
-    } else {
-      parent = (cmp < 0) ? &root->left : &root->right;
-      root = (cmp < 0) ? root->left : root->right;
-    }
+  STATE **work;
+  int i;
+
+  if (!Pending) {
+    Pending = newset();
   }
 
-  if (!root) { /* node isn't in tree. allocate a new node and put it into the tree */
-    if (Available) {
-      *parent = Available;    /* use node from available list if possible */
-      Available = (TNODE *)Available->left;
-    } else {  /* otherwise get the node from the Heap */
-      if (Next_allocate >= &Heap[MAX_UNFINISHED]) {
-        error(FATAL, "no memory for unfinished state\n");
-      }
-      *parent = Next_allocate++;
+  if (MEMBER(Pending, state->num)) {
+    return;
+  }
+
+  ADD(Pending, state->num);
+  ++Npending;
+  Max_pending = max(Max_pending, Npending);
+
+  if (Work_order == 'n') {
+    Low = min(Low, state->num);
+    return;
+  }
+
+  if (Npending > Work_max) {  /* the ring is full, copy it to a larger one */
+    if (!(work = (STATE **) mem_alloc(MEM_STATES, (Work_max = max(Work_max * 2, 64)) * sizeof(STATE *)))) {
+      error(FATAL, "no memory for unfinished states\n");
+    }
+    for (i = 0; i < Npending - 1; ++i) {
+      work[i] = Work[(Work_head + i) % (Npending - 1)];
     }
-    (*parent)->state = state;           /* initialize the node */
-    (*parent)->left = (*parent)->right = NULL;
+    mem_free(Work);
+    Work = work;
+    Work_head = 0;
   }
+  Work[(Work_head + Npending - 1) % Work_max] = state;
 }
 
 
 static STATE *get_unfinished()
 {
   /* returns a pointer to the next unfinished state and deletes that
-   * state from the unfinished tree. returns NULL if the tree is empty.
+   * state from the unfinished list. returns NULL if the list is empty.
    */
-  TNODE *root;
-  TNODE **parent;
 
-  if (!Unfinished) {
+  STATE *state;
+
+  if (!Npending) {
     return NULL;
   }
 
-  parent = &Unfinished;
-  root = Unfinished;    /* find leftmost node */
-
-  while(root->left) {
-    parent = &root->left;
-    root = root->left;
+  switch (Work_order) {
+    case 'f':
+      state = Work[Work_head];
+      Work_head = (Work_head + 1) % Work_max;
+      break;
+    case 'l':
+      state = Work[(Work_head + Npending - 1) % Work_max];
+      break;
+    default:
+      state = Statev[Low = next_after(Pending, Low - 1)];
+      break;
   }
 
-  *parent = root->right;
-  root->left = Available;
-  Available = root;
-  
-  return root->state;
+  REMOVE(Pending, state->num);
+  --Npending;
+
+  if (state->closed) {
+    ++Nrevisits;
+  }
+  return state;
 }
 
 static char *strprod(PRODUCTION *prod)
@@ -522,62 +988,29 @@ static char *strprod(PRODUCTION *prod)
   return buf;
 }
 
-static ITEM *newitem(PRODUCTION *production)
+static ITEM *newitem(WORKER *w, PRODUCTION *production)
 {
-  ITEM *item;
+  /* make a closure item in the worker's scratch arena */
 
-  if (Recycled_items) {
-    item = Recycled_items;
-    Recycled_items = (ITEM *) Recycled_items->prod;
-    CLEAR(item->lookaheads);
-  } else {
-    if (!(item = (ITEM *) malloc(sizeof(ITEM)))) {
-      error(FATAL, "no memory for LALR(1) items\n");
-    }
-    item->lookaheads = newset();
-  }
+  ITEM *item = arena_item(&w->scratch);
   
   if (Verbose > 1) {
     printf("making new item for %s\n", strprod(production));
   }
 
-  ++Nitems;
-  item->prod = production;
-  item->prod_num = production->num;
-  item->dot_posn = 0;
-  item->right_of_dot = production->rhs[0];
+  item->id = Prod_base[production->num];
   return item;
 }
 
-static void freeitem(ITEM *item) {
-  --Nitems;
-  item->prod = (PRODUCTION *) Recycled_items;
-  Recycled_items = item;
-}
-
-static void free_recycled_items()
-{
-  /* empty the recycling list, freeing all memory used by items there */
-
-  ITEM *p;
-
-  while (p = Recycled_items) {
-    Recycled_items = (ITEM *) Recycled_items->prod;
-    free(p);
-  }
-}
-
 static void movedot(ITEM *item)
 {
-  /* moves the dot one position to the right and updates the right_of_dot
-   * symbol
-   */
+  /* moves the dot one position to the right */
   
-  if (item->right_of_dot == NULL) {
+  if (!NEXT_SYM(item)) {
     error(FATAL, "illegal movedot() call on epsilon production\n");
   }
 
-  item->right_of_dot = (item->prod->rhs)[++item->dot_posn];
+  ++item->id;
 }
 
 
@@ -590,9 +1023,7 @@ static int item_cmp(const void *item1p, const void *item2p)
   ITEM *item2 = *(ITEM **) item2p;
 
   if (!(rval = RIGHT_OF_DOT(item1) - RIGHT_OF_DOT(item2))) {
-    if (!(rval = item1->prod_num - item2->prod_num)) {
-      return item1->dot_posn - item2->dot_posn;
-    }
+    return item1->id - item2->id;
   }
 
   return rval;
@@ -613,13 +1044,16 @@ static int merge_lookaheads(ITEM **dst_items, ITEM **src_items, int nitems)
   int did_something = 0;
   
   while (--nitems >= 0) {
-    if ((*dst_items)->prod != (*src_items)->prod || (*dst_items)->dot_posn != (*src_items)->dot_posn) {
+    if ((*dst_items)->id != (*src_items)->id) {
       error(FATAL, "merge_lookahead item mismatch");
     }
 
+    ++Workers->nmerges;
+    ++Workers->nset_tests;
     if (!subset((*dst_items)->lookaheads, (*src_items)->lookaheads)) {
       ++did_something;
-      UNION((*dst_items)->lookaheads, (*src_items)->lookaheads);
+      ++Workers->nchanged;
+      (*dst_items)->lookaheads = la_union(Workers, (*dst_items)->lookaheads, (*src_items)->lookaheads);
     }
     ++dst_items;
     ++src_items;
@@ -639,32 +1073,42 @@ static int move_eps(STATE *cur_state, ITEM **closure_items, int nclose)
    * the number of items that were moved.
    */
   
-  ITEM **eps_items, **p;
-  int nitems, moved;
+  ITEM **eps_items;
+  SET *set;
+  int i, moved;
 
-  eps_items = cur_state->epsilon_items;
-  nitems = cur_state->neitems;
-  moved = 0;
+  for (moved = 0; moved < nclose && ITEM_PROD(closure_items[moved])->rhs_len == 0; ++moved) {
+    ;
+  }
 
-  for (p = closure_items; --nclose >= 0 && (*p)->prod->rhs_len ==0; ) {
-    if (++moved > MAXEPSILON) {
-      error(FATAL, "too many epsilon productions in state %d\n", cur_state->num);
-    }
-    if (nitems) {
-      UNION((*eps_items++)->lookaheads, (*p++)->lookaheads);
-    } else {
-      *eps_items++ = *p++;
-    }
+  if (!moved) {
+    return 0;
   }
 
-  if (moved) {
+  if (!cur_state->neitems) {
+    if (!(eps_items = (ITEM **) mem_alloc(MEM_ITEMS, moved * sizeof(ITEM *)))) {
+      error(FATAL, "no memory for epsilon items\n");
+    }
+    for (i = 0; i < moved; ++i) {
+      eps_items[i] = keepitem(closure_items[i]);
+    }
+    cur_state->epsilon_items = eps_items;
     cur_state->neitems = moved;
+  } else {
+    eps_items = cur_state->epsilon_items;
+    for (i = 0; i < moved; ++i) {
+      set = eps_items[i]->lookaheads;
+      eps_items[i]->lookaheads = la_union(Workers, set, closure_items[i]->lookaheads);
+      ++Workers->nmerges;
+      Workers->nchanged += eps_items[i]->lookaheads != set;  /* interned, see la_union() */
+    }
   }
+
   return moved;
 }
 
 
-static int kclosure(STATE *kernel, ITEM **closure_items, int maxitems, int nclose)
+static int kclosure(WORKER *w, STATE *kernel, ITEM **closure_items, int maxitems, int nclose)
 {
   /* kernel: kernel state to close 
    * closure_items: array into which closure items are put
@@ -687,12 +1131,10 @@ static int kclosure(STATE *kernel, ITEM **closure_items, int maxitems, int nclos
 
   while (--nitems >= 0) {
     item = *itemp++;
-    if (item->right_of_dot) {
-      citem = newitem(item->prod);
-      citem->prod = item->prod;
-      citem->dot_posn = item->dot_posn;
-      citem->right_of_dot = item->right_of_dot;
-      citem->lookaheads = dupset(item->lookaheads);
+    if (NEXT_SYM(item)) {
+      citem = newitem(w, ITEM_PROD(item));
+      citem->id = item->id;
+      citem->lookaheads = item->lookaheads;  /* shared, not copied */
       if (--maxitems < 0) {
         error(FATAL, "too many closure items in state %d\n", kernel->num);
       }
@@ -710,8 +1152,10 @@ static ITEM *in_closure_items(PRODUCTION *production, ITEM **closure_items, int
    * pointer to the existing item, otherwise return NULL.
    */
   
+  int id = Prod_base[production->num];
+
   for (; --nitems >= 0; ++closure_items) {
-    if ((*closure_items)->prod == production) {
+    if ((*closure_items)->id == id) {
       return *closure_items;
     }
   }
@@ -719,22 +1163,25 @@ static ITEM *in_closure_items(PRODUCTION *production, ITEM **closure_items, int
   return NULL;
 }
 
-static int add_lookahead(SET *dst, SET *src)
+static int add_lookahead(WORKER *w, SET **dst, SET *src)
 {
-  /* merge the lookaheads in the src and dst sets. if the original src
+  /* merge the lookaheads in the src and *dst sets. if the original src
    * set was empty, or if it was already a subset of the destination set,
-   * return 0, otherwise return 1.
+   * return 0, otherwise point *dst at the union and return 1.
    */
   
-  if (!IS_EMPTY(src) && !subset(dst, src)) {
-    UNION(dst, src);
+  ++w->nmerges;
+  w->nset_tests += 2;
+  if (!IS_EMPTY(src) && !subset(*dst, src)) {
+    *dst = la_union(w, *dst, src);
+    ++w->nchanged;
     return 1;
   }
 
   return 0;
 }
 
-static int do_close(ITEM *item, ITEM *closure_items[], int *nitems, int *maxitems)
+static int do_close(WORKER *w, ITEM *item, ITEM *closure_items[], int *nitems, int *maxitems)
 {
   /* closure_items: (output) array of items added by closure process 
    * nitems: (input) # of items currently in closure_items[] 
@@ -756,19 +1203,19 @@ static int do_close(ITEM *item, ITEM *closure_items[], int *nitems, int *maxitem
   int rhs_is_nullable;
   PRODUCTION *prod;
   ITEM *close_item;
-  SET *closure_set;
+  SET *closure_set = w->closure_set;
   SYMBOL **symp;
+  int dot;
 
-  if (!item->right_of_dot) {
+  ++w->ndo_close;
+  if (!NEXT_SYM(item)) {
     return 0;
   }
 
-  if (!ISNONTERM(item->right_of_dot)) {
+  if (!ISNONTERM(NEXT_SYM(item))) {
     return 0;
   }
 
-  closure_set = newset();
-
   /* the symbol to the right of the dot is a nonterminal. do the following:
    *
    *(1) for (every production attached to that nonterminal)
@@ -781,34 +1228,37 @@ static int do_close(ITEM *item, ITEM *closure_items[], int *nitems, int *maxitem
    *    it to the lookaheads for the current item if necessary.
    */
 
-  for (prod = item->right_of_dot->productions; prod; prod = prod->next) { /* (1) */
+  dot = DOT_POSN(item);
+
+  for (prod = NEXT_SYM(item)->productions; prod; prod = prod->next) { /* (1) */
     if (!(close_item = in_closure_items(prod, closure_items, *nitems))) { /* (2) */
       if (--(*maxitems) < 0) {
         error(FATAL, "LR(1) closure set too large\n");
       }
-      closure_items[(*nitems)++] = close_item = newitem(prod);  /* (3) */
+      closure_items[(*nitems)++] = close_item = newitem(w, prod);  /* (3) */
       ++did_something;
     }
 
-    if (!*(symp = &(item->prod->rhs[item->dot_posn + 1]))) {    /* (4) */
-      did_something |= add_lookahead(close_item->lookaheads, item->lookaheads);   /* (5) */
+    if (!*(symp = &(ITEM_PROD(item)->rhs[dot + 1]))) {    /* (4) */
+      did_something |= add_lookahead(w, &close_item->lookaheads, item->lookaheads);   /* (5) */
     } else {
-      truncate(closure_set); /* (6) */
-      rhs_is_nullable = first_rhs(closure_set, symp, item->prod->rhs_len - item->dot_posn - 1);
+      w->nset_ops += 2;
+      CLEAR(closure_set); /* (6) */
+      rhs_is_nullable = first_rhs(closure_set, symp, ITEM_PROD(item)->rhs_len - dot - 1);
       REMOVE(closure_set, EPSILON);
       if (rhs_is_nullable) {
+        ++w->nset_ops;
         UNION(closure_set, item->lookaheads);
       }
 
-      did_something |= add_lookahead(close_item->lookaheads, closure_set);
+      did_something |= add_lookahead(w, &close_item->lookaheads, closure_set);
     }
   }
   
-  delset(closure_set);
   return did_something;
 }
 
-static int closure(STATE *kernel, ITEM *closure_items[], int maxitems)
+static int closure(WORKER *w, STATE *kernel, ITEM *closure_items[], int maxitems)
 {
   /* kernel: kernel state to close
    * closure_items: array into which closure items are put
@@ -829,25 +1279,70 @@ static int closure(STATE *kernel, ITEM *closure_items[], int maxitems)
   int did_something = 0;
   ITEM **p = kernel->kernel_items;
 
+  ++w->nclosures;
+
   for (i = kernel->nkitems; --i >= 0; ) {   /* (1) */
-    did_something |= do_close(*p++, closure_items, &nclose, &maxitems);
+    did_something |= do_close(w, *p++, closure_items, &nclose, &maxitems);
   }
 
   while (did_something) { /* (2) */
     did_something = 0;
     p = closure_items;
     for (i = nclose; --i >= 0;) {
-      did_something |= do_close(*p++, closure_items, &nclose, &maxitems);
+      did_something |= do_close(w, *p++, closure_items, &nclose, &maxitems);
     }
   }
 
   return nclose;
 }
 
-static void reduce_one_item(STATE *state, ITEM *item)
+static CONFLICT *add_conflict(CONFLICT_LOG *log, int state, int token, int prod, int other, int choice, int resolved)
+{
+  /* add a conflict to the end of the log and return a pointer to it */
+
+  CONFLICT *c;
+
+  if (log->nconflicts >= log->maxconflicts) {
+    log->maxconflicts = log->maxconflicts ? log->maxconflicts * 2 : 16;
+    if (!(log->conflicts = (CONFLICT *) mem_realloc(MEM_LR, log->conflicts, log->maxconflicts * sizeof(CONFLICT)))) {
+      error(FATAL, "no memory for conflict log\n");
+    }
+  }
+
+  c = &log->conflicts[log->nconflicts++];
+  c->state    = state;
+  c->token    = token;
+  c->prod     = prod;
+  c->other    = other;
+  c->choice   = choice;
+  c->resolved = resolved;
+  return c;
+}
+
+static void pconflict(CONFLICT *c)
+{
+  /* count a conflict and print the warning for it */
+
+  if (c->other >= 0) {
+    ++Reduce_reduce;
+    error(WARNING, "state %2d: reduce/reduce conflict ", c->state);
+    error(NOHDR, "%d/%d on %s (choose %d)\n", c->other, 
+          c->prod, c->token ? Terms[c->token]->name : "<_EOI_>", c->choice);
+  } else {
+    ++Shift_reduce;
+    error(WARNING,"state %2d: shift/reduce conflict ", c->state);
+    error(NOHDR, "%s/%d (choose %s) %s\n", Terms[c->token]->name, c->prod,
+          c->choice < 0 ? "reduce" : "shift", 
+          c->resolved ? "(resolved)" : "");
+  }
+}
+
+static void reduce_one_item(WORKER *w, STATE *state, ITEM *item)
 {
   /* item: reduce on this item 
    * state: from this state
+   *
+   * conflicts are logged in the worker, report_state() prints them.
    */
   
   int token;      /* current lookahead */
@@ -856,19 +1351,21 @@ static void reduce_one_item(STATE *state, ITEM *item)
   int assoc;      /* associativity of token */
   int reduce_by;
   int resolved;   /* true if conflict can be resolved */
+  int prod_num;   /* production to reduce by */
   ACT *ap;
 
-  if (item->right_of_dot) { /* no reduction required */
+  if (NEXT_SYM(item)) { /* no reduction required */
     return;
   }
 
-  pprec = item->prod->prec; /* precedence of entire production */
+  prod_num = ITEM_PROD(item)->num;
+  pprec = ITEM_PROD(item)->prec; /* precedence of entire production */
   
   if (Verbose > 1) {
     printf("ITEM: %s\n", stritem(item, 1));
   }
 
-  for (next_member(NULL); (token = next_member(item->lookaheads)) >= 0; ) {
+  for (token = -1; (token = next_after(item->lookaheads, token)) >= 0; ) {
     tprec = Precedence[token].level;  /* precedence of lookahead symbol */
     assoc = Precedence[token].assoc;
 
@@ -877,49 +1374,42 @@ static void reduce_one_item(STATE *state, ITEM *item)
     }
 
     if (!(ap = p_action(state->num, token))) { /* no conflicts */
-      add_action(state->num, token, -(item->prod_num));
+      add_action(w, state->num, token, -(prod_num));
       if (Verbose > 1) {
-        printf("Action[%d][%s]=%d\n", state->num, Terms[token]->name, -(item->prod_num));
+        printf("Action[%d][%s]=%d\n", state->num, Terms[token]->name, -(prod_num));
       }
     } else if (ap->do_this <= 0) {
       /* resolve a reduce/reduce conflict in favor of the production with the smaller number
        * print a warning
        */
-      ++Reduce_reduce;
-      reduce_by = min(-(ap->do_this), item->prod_num);
-
-      error(WARNING, "state %2d: reduce/reduce conflict ", state->num);
-      error(NOHDR, "%d/%d on %s (choose %d)\n", -(ap->do_this), 
-            item->prod_num, token ? Terms[token]->name : "<_EOI_>", reduce_by);
+      reduce_by = min(-(ap->do_this), prod_num);
+      add_conflict(&w->log, state->num, token, prod_num, -(ap->do_this), reduce_by, 0);
       ap->do_this = -reduce_by;
     } else {
       /* shift/reduce conflict */
       if (resolved = (pprec && tprec)) {
         if (tprec < pprec || (pprec == tprec && assoc == 'l')) {
-          ap->do_this = -(item->prod_num);
+          ap->do_this = -(prod_num);
         }
       }
 
       if (Verbose > 0 || !resolved) {
-        ++Shift_reduce;
-        error(WARNING,"state %2d: shift/reduce conflict ", state->num);
-        error(NOHDR, "%s/%d (choose %s) %s\n", Terms[token]->name, item->prod_num,
-              ap->do_this < 0 ? "reduce" : "shift", 
-              resolved ? "(resolved)" : "");
+        add_conflict(&w->log, state->num, token, prod_num, -1, ap->do_this, resolved);
       }
     }
   }
 }
 
-static void addreductions(STATE *state, void *junk)
+static void addreductions(WORKER *w, int num)
 {
   /* this routine is called for each state. it adds the reductions using the
-   * disambiguating rules described in the text, and then prints the state to
-   * y.output if Verbose is true
+   * disambiguating rules described in the text. report_state() is called
+   * for the state afterwards.
    */
   
   int i;
   ITEM **item_p;
+  STATE *state = Statev[num];
 
   if (Verbose > 1) {
     printf("----------------------------------\n");
@@ -928,28 +1418,58 @@ static void addreductions(STATE *state, void *junk)
   }
 
   for (i = state->nkitems, item_p = state->kernel_items; --i >= 0; ++item_p) {
-    reduce_one_item(state, *item_p);
+    reduce_one_item(w, state, *item_p);
   }
 
   for (i = state->neitems, item_p = state->epsilon_items; --i >= 0; ++item_p) {
-    reduce_one_item(state, *item_p);
+    reduce_one_item(w, state, *item_p);
+  }
+}
+
+static void report_state(int num)
+{
+  /* print the conflicts that addreductions() found in state num, and then
+   * print the state to y.output if Verbose is true. the conflicts are moved
+   * to the Conflicts log. the states must be reported in order: every
+   * worker's log is in state order, and all of a state's conflicts are in
+   * the log of the worker that did the state.
+   */
+
+  WORKER *w;
+  CONFLICT *c;
+
+  for (w = Workers; w < Workers + Nworkers; ++w) {
+    while (w->reported < w->log.nconflicts && (c = &w->log.conflicts[w->reported])->state == num) {
+      ++w->reported;
+      pconflict(add_conflict(&Conflicts, c->state, c->token, c->prod, c->other, c->choice, c->resolved));
+    }
   }
 
   if (Verbose) {
-    pstate(state);
+    pstate(Statev[num]);
   }
 }
 
 static void reductions()
 {
-  /* do the reductions. if there's memory, sort the table by state number
-   * first so that y.output will look nice
+  /* do the reductions. the states are independent, so with -j they're done
+   * in parallel. the warnings and y.output are printed afterwards, in state
+   * order, so they come out the same either way.
    */
-  
-  Sort_by_number = 1;
-  if (!ptab(States, (ptab_t)addreductions, NULL, 1)) {
-    ptab(States, (ptab_t)addreductions, NULL, 0);
-  }
+
+  int i;
+
+  if (Nworkers > 1) {
+    parallel_for(Nstates, 8, addreductions);
+    for (i = 0; i < Nstates; ++i) {
+      report_state(i);
+    }
+  } else {
+    for (i = 0; i < Nstates; ++i) {  /* -V traces have to come out in order */
+      addreductions(Workers, i);
+      report_state(i);
+    }
+  }
 }
 
 static void make_yy_lhs(PRODUCTION **prodtab)
@@ -1013,6 +1533,122 @@ static void make_yy_reduce(PRODUCTION **prodtab)
 }
 
 
+static void make_yy_prods(PRODUCTION **prodtab)
+{
+  /* the production strings, table sizes and other things used by the
+   * driver's profiling code, which is only compiled in when YYPROFILE is
+   * defined
+   */
+
+  static char *text[] = {
+    "Yy_prods[] is indexed by production number and holds the production",
+    "as a string. Yy_natural[] is indexed by state number and holds the",
+    "number that rbison gave the state before it renumbered the states",
+    "(with --profile). they're only used by yyprofile(), when YYPROFILE is",
+    "defined. YYNSTATES, YYNPRODS, YYNTOKENS and YYNNONTERMS are the",
+    "number of states, productions, columns of Yy_action and columns of",
+    "Yy_goto. YYGRAMMAR identifies the grammar",
+    NULL
+  };
+
+  int i;
+
+  comment(Output, text);
+  output("#ifdef YYPROFILE\n");
+  output("#define YYNSTATES   %d\n", Nstates);
+  output("#define YYNPRODS    %d\n", Num_productions);
+  output("#define YYNTOKENS   %d\n", ACTION_COLS);
+  output("#define YYNNONTERMS %d\n", GOTO_COLS);
+  output("#define YYGRAMMAR   \"%016llx\"\n\n", grammar_fingerprint());
+  output("YYPRIVATE char *Yy_prods[%d] = \n{\n", Num_productions);
+
+  for (i = 0; i < Num_productions; ++i) {
+    output("  /* %3d */  \"%s\"%s\n", prodtab[i]->num, production_str(prodtab[i]),
+           i != Num_productions - 1 ? "," : "");
+  }
+
+  output("};\n\nYYPRIVATE int Yy_natural[%d] = \n{", Nstates);
+
+  for (i = 0; i < Nstates; ++i) {
+    if (i % 10 == 0) {
+      output("\n/* %3d */ ", i);
+    }
+    output(" %d%s", Natural ? Natural[i] : i, i != Nstates - 1 ? "," : "");
+  }
+
+  output("\n};\n#endif\n");
+}
+
+static int needs(PRODUCTION *prod)
+{
+  /* the Yy_needs[] entry for prod, see below */
+
+  int n = 0;
+
+  if (prod->has_action) {
+    n |= NEED_ACT;
+  }
+  if (prod->uses_text) {
+    n |= NEED_TEXT;
+  }
+  if (prod->sets_val || prod->in_place) {
+    n |= NO_COPY;
+  }
+  if (prod->in_place) {
+    n |= IN_PLACE;
+  }
+  return n;
+}
+
+static void make_yy_needs(PRODUCTION **prodtab)
+{
+  /* print what the driver has to do when it reduces by each production
+   * (see has_action, uses_text, sets_val and in_place in yypatch.c).
+   * nothing is printed if it has to do everything for all of them, the
+   * driver then assumes that it does.
+   */
+
+  static char *text[] = {
+    "Yy_needs[] is indexed by production number. it says what the driver",
+    "has to do when it reduces by each production, it's the sum of:",
+    "",
+    "    1  call yy_act(), there's an action",
+    "    2  set up yytext, yyleng and yylineno ('\\0'-terminate the lexeme)",
+    "       for the action first. only used if the parser is compiled with",
+    "       -DYYLAZY, they're set up for every action otherwise. don't use",
+    "       YYLAZY if an action calls a function that reads them",
+    "    4  don't copy $1 to $$ first, the action sets $$ itself or $$ is",
+    "       in place",
+    "    8  $$ is in place: it's in $1's place on the value stack (there's",
+    "       no action, or the action puts it there), so it's not copied",
+    "       from Yy_val after the action",
+    NULL
+  };
+
+  int i, all = 0;
+
+  for (Nact = Ntext = Nplace = i = 0; i < Num_productions; ++i) {
+    Nact += prodtab[i]->has_action != 0;
+    Ntext += prodtab[i]->uses_text != 0;
+    Nplace += prodtab[i]->in_place != 0;
+    all += needs(prodtab[i]) == (NEED_ACT | NEED_TEXT);
+  }
+
+  if (all < Num_productions) {
+    comment(Output, text);
+    output("#define YYNEEDS(prod) Yy_needs[prod]\n\n");
+    output("YYPRIVATE unsigned char Yy_needs[%d] = \n{", Num_productions);
+
+    for (i = 0; i < Num_productions; ++i) {
+      if (i % 10 == 0) {
+        output("\n/* %3d */ ", i);
+      }
+      output(" %2d%s", needs(prodtab[i]), i != Num_productions - 1 ? "," : "");
+    }
+    output("\n};\n");
+  }
+}
+
 static void mkprod(SYMBOL *sym, PRODUCTION **prodtab)
 {
   PRODUCTION *p;
@@ -1033,24 +1669,126 @@ static void mkprod(SYMBOL *sym, PRODUCTION **prodtab)
  * the default transition is the error transition
  */
 
-static void print_reductions()
+typedef struct _text_ {   /* a string that grows as it's printed into */
+  char *buf;
+  int len;
+  int max;
+} TEXT;
+
+static void tprintf(TEXT *t, char *fmt, ...)
 {
-  /* output the various tables needed to do reductions */
-  PRODUCTION **prodtab;
+  /* works like sprintf(), but appends to t, making it larger as needed */
 
-  if (!(prodtab = (PRODUCTION**) malloc (sizeof(PRODUCTION *) * Num_productions))) {
-    error(FATAL, "no memory to output LALR(1) reduction tables\n");
-  } else {
-    ptab(Symtab, (ptab_t)mkprod, prodtab, 0);
+  va_list args;
+  int n;
+
+  for (;;) {
+    va_start(args, fmt);
+    n = vsnprintf(t->buf + t->len, t->max - t->len, fmt, args);
+    va_end(args);
+
+    if (t->len + n < t->max) {
+      t->len += n;
+      return;
+    }
+
+    t->max = max(t->max * 2, t->len + n + MAXOBUF);
+    if (!(t->buf = (char *) mem_realloc(MEM_OUTPUT, t->buf, t->max))) {
+      error(FATAL, "no memory for table output\n");
+    }
+  }
+}
+
+/* used by print_tab() to pass information to its parallel_for() bodies */
+static ROW *Tab;              /* the table being printed */
+static char *Row_name;
+static unsigned int *Row_hash;
+static int *Same_row;         /* Same_row[i]: first row that's the same as row i */
+static TEXT *Row_text;        /* the row arrays */
+
+static void hash_row(WORKER *w, int i)
+{
+  ACT *p;
+  unsigned int h = Tab[i].nacts;
+
+  for (p = Tab[i].acts; p < Tab[i].acts + Tab[i].nacts; ++p) {
+    h = mix(mix(h, p->sym), p->do_this);
+  }
+  Row_hash[i] = h;
+}
+
+static void find_same_row(WORKER *w, int j)
+{
+  /* find the first row that's the same as row j. row j is redundant if
+   * that's an earlier row. empty rows are never redundant.
+   */
+
+  int i;
+
+  Same_row[j] = j;
+  if (!Tab[j].nacts) {
+    return;
+  }
+
+  for (i = 0; i < j; ++i) {
+    if (Row_hash[i] == Row_hash[j] && Tab[i].nacts == Tab[j].nacts
+          && !memcmp(Tab[i].acts, Tab[j].acts, Tab[j].nacts * sizeof(ACT))) {
+      Same_row[j] = i;
+      return;
+    }
+  }
+}
+
+static void same_rows(ROW *table)
+{
+  /* fill Same_row[] for table. finding the duplicates is done in parallel
+   * (with -j). the caller frees Same_row.
+   */
+
+  Tab = table;
+  if (!(Row_hash = (unsigned int *) mem_alloc(MEM_OUTPUT, Nstates * sizeof(unsigned int)))
+        || !(Same_row = (int *) mem_alloc(MEM_OUTPUT, Nstates * sizeof(int)))) {
+    error(FATAL, "no memory for table output\n");
   }
 
-  make_yy_lhs(prodtab);
-  make_yy_reduce(prodtab);
+  parallel_for(Nstates, 16, hash_row);
+  parallel_for(Nstates, 4, find_same_row);
+  mem_free(Row_hash);
+}
+
+static void format_row(WORKER *w, int i)
+{
+  /* print the array for row i into Row_text[i] */
+
+  ACT *ele;
+  TEXT *t = &Row_text[i];
+  int count;        /* # of transitions from this state, always > 0 */
+  int column;
+  int k;
+
+  memset(t, 0, sizeof(TEXT));
+  if (!(count = Tab[i].nacts) || Same_row[i] != i) {
+    return;
+  }
+
+  tprintf(t, "YYPRIVATE YY_TTYPE %s%03d[] = {%2d, ", Row_name, i, count);
+
+  column = 0;
+  for (k = count; --k >= 0; ) {   /* newest first */
+    ele = &Tab[i].acts[k];
+    tprintf(t, "%3d,%d", ele->sym, ele->do_this);
 
-  free(prodtab);
+    if (++column != count) {
+      tprintf(t, ",");
+    }
+    if (column % 5 == 0) {
+      tprintf(t, "\n          ");
+    }
+  }
+  tprintf(t, "};\n");
 }
 
-static void print_tab(ACT **table, char *row_name, char *col_name, int make_private)
+static void print_tab(ROW *table, char *row_name, char *col_name, int make_private)
 {
   /*
    * row_name: name to use for row arrays;
@@ -1060,13 +1798,7 @@ static void print_tab(ACT **table, char *row_name, char *col_name, int make_priv
   
   /* output the action and goto table */
 
-  int i, j;
-  ACT *ele, **elep; /* table element and pointer to same */
-  ACT *e, **p;
-  int count;        /* # of transitions from this state, always > 0 */
-  int column;
-  SET *redundant = newset();  /* mark redundant rows */
-
+  int i;
 
   static char *act_text[] = {
     "the Yy_action table is action part of the LALR(1) transition",
@@ -1109,216 +1841,587 @@ static void print_tab(ACT **table, char *row_name, char *col_name, int make_priv
   comment(Output, table == Actions ? act_text : goto_text);
 
   /*
-   * modify the matrix so that, if a duplicate rows exists, only one
-   * copy of it is kept around. the extra rows are marked as such by setting
-   * a bit in the "redundant" set. (the memory used for the chains is just
-   * discarded) the redundant table element is made to point at the row
-   * that it duplicates
+   * if duplicate rows exist, only one copy of each is printed. the rows are
+   * independent, so finding the duplicates and printing the rows into
+   * memory is done in parallel (with -j). they're written out in order.
    */
 
-  
-  for (elep = table, i = 0; i < Nstates; ++elep, i++) {
-    if (MEMBER(redundant, i)) {
-      continue;
+  same_rows(table);
+  Row_name = row_name;
+  if (!(Row_text = (TEXT *) mem_alloc(MEM_OUTPUT, Nstates * sizeof(TEXT)))) {
+    error(FATAL, "no memory for table output\n");
+  }
+
+  parallel_for(Nstates, 16, format_row);
+
+  /* output the row arrays */
+
+  for (i = 0; i < Nstates; i++) {
+    if (Row_text[i].buf) {
+      output("%s", Row_text[i].buf);
+      mem_free(Row_text[i].buf);
+      Npairs += table[i].nacts;
+      ++Nrows;
     }
+  }
 
-    for (p = elep + 1, j = i + 1; j < Nstates; ++p, ++j) {
-      if (MEMBER(redundant, j)) {
-        continue;
-      }
+  if (make_private) {
+    output("\nYYPRIVATE YY_TTYPE *%s[%d] = \n", col_name, Nstates);
+  } else {
+    output("\nYY_TTYPE *%s[%d] = \n", col_name, Nstates);
+  }
 
-      ele = *elep;    /* pointer to template chain */
-      e = *p;         /* chain to compare against template */
-      if (!e || !ele) { /* either or both strings have no elements */
-        continue;
-      }
+  output("{");
 
-      for (; ele && e; ele = ele->next, e = e->next) {
-        if ((ele->do_this != e->do_this) || (ele->sym != e->sym)) {
-          break;
-        }
-      }
+  for (i = 0; i < Nstates; i++) {
+    if (i == 0 || (i % 8) == 0) {
+      output("\n/* %3d */ ", i);
+    }
+    output(table[i].nacts ? "%s%03d" : " NULL", row_name, Same_row[i]);
 
-      if (!e && !ele) {
-        /* then the chains are the same. mark the chain being compared
-         * as redundant, and modify table[j] to hold a pointer to the
-         * template pointer
-         */
-        ADD(redundant, j);
-        table[j] = (ACT *) elep;
-      }
+    if (i != Nstates - 1) {
+      output(", ");
     }
   }
+  output("\n};\n");
 
-  /* output the row arrays */
+  mem_free(Row_text);
+  mem_free(Same_row);
+}
 
-  for (elep = table, i = 0; i < Nstates; ++elep, i++) {
-    if (!*elep || MEMBER(redundant, i)) {
-      continue;
-    }
+/*
+ * -b writes the tables to BIN_FILE instead of printing them. the file is
+ * mapped into memory as it is by yy_load_tables() in the driver, so nothing
+ * in it is a pointer: the header (TABHDR in parser.h) gives where each
+ * section starts, Yy_action and Yy_goto hold the offsets of the rows in the
+ * pool, and Yy_stok holds the offsets of the token names. the layout is
+ * that of the machine that rbison runs on. librbison.c uses the same layout
+ * for the tables that it keeps in memory.
+ */
 
-    /* count the number of transitions from this state */
+static short *Pool;               /* the rows, as they go in BIN_FILE */
+static int Npool = 0;
+static int Max_pool = 0;
 
-    count = 0;
-    for (ele = *elep; ele; ele = ele->next) {
-      count++;
+static void pool_add(int n)
+{
+  if (Npool >= Max_pool) {
+    Max_pool = max(Max_pool * 2, 1024);
+    if (!(Pool = (short *) mem_realloc(MEM_OUTPUT, Pool, Max_pool * sizeof(short)))) {
+      error(FATAL, "no memory for %s\n", BIN_FILE);
     }
+  }
+  Pool[Npool++] = n;
+}
 
-    output("YYPRIVATE YY_TTYPE %s%03d[] = {%2d, ", row_name, (int) (elep - table), count);
+static void pool_table(ROW *table, int *offsets)
+{
+  /* add the rows of table to Pool the way that print_tab() prints them, and
+   * put where each one starts in offsets[] (-1 for an empty row). a row
+   * that's the same as an earlier one isn't added again.
+   */
 
-    column = 0;
-    for (ele = *elep; ele; ele = ele->next) {
-      ++Npairs;
-      output("%3d,%d", ele->sym, ele->do_this);
+  int i, k;
 
-      if (++column != count) {
-        outc(',');
-      }
-      if (column % 5 == 0) {
-        output("\n          ");
+  same_rows(table);
+
+  for (i = 0; i < Nstates; i++) {
+    if (!table[i].nacts) {
+      offsets[i] = -1;
+    } else if (Same_row[i] != i) {
+      offsets[i] = offsets[Same_row[i]];
+    } else {
+      offsets[i] = Npool;
+      pool_add(table[i].nacts);
+      for (k = table[i].nacts; --k >= 0; ) {   /* newest first */
+        pool_add(table[i].acts[k].sym);
+        pool_add(table[i].acts[k].do_this);
       }
+      Npairs += table[i].nacts;
+      ++Nrows;
     }
-    output("};\n");
   }
 
-  if (make_private) {
-    output("\nYYPRIVATE YY_TTYPE *%s[%d] = \n", col_name, Nstates);
+  mem_free(Same_row);
+}
+
+static void write_tabfile(PRODUCTION **prodtab)
+{
+  /* write Yy_action, Yy_goto, Yy_lhs, Yy_reduce and Yy_stok to BIN_FILE,
+   * and print YYTABNPRODS, which yy_load_tables() checks the file against.
+   * the file is written under a temporary name and renamed, so that a
+   * parser that has the old one mapped isn't pulled out from under.
+   */
+
+  static char *text[] = {
+    "the tables are in YYTABFILE, written by rbison -b or -B. it's loaded by",
+    "yy_load_tables(), which only accepts a file with YYTABNPRODS",
+    "productions because that's how many cases yy_act() has",
+    NULL
+  };
+
+  static char tmp_name[] = BIN_FILE ".tmp";
+  TABHDR hdr;
+  TEXT strings;
+  int *offsets, i, ntoks = Cur_term - MINTERM + 2;
+  unsigned int sum = 2166136261U;   /* 32-bit FNV-1a */
+  unsigned char *q;
+  char *buf;
+  FILE *fp;
+
+  memset(&hdr, 0, sizeof(hdr));
+  memset(&strings, 0, sizeof(strings));
+  memcpy(hdr.magic, TABFILE_MAGIC, sizeof(TABFILE_MAGIC));
+  hdr.version    = TABFILE_VERSION;
+  hdr.byteorder  = 0x01020304;
+  hdr.ttype_size = sizeof(short);
+  hdr.nstates    = Nstates;
+  hdr.nprods     = Num_productions;
+  hdr.ntoks      = ntoks;
+
+#define SECTION(field, bytes) (hdr.field = hdr.size, hdr.size += ((bytes) + sizeof(int) - 1) & ~(sizeof(int) - 1))
+
+  hdr.size = sizeof(hdr);
+  SECTION(action,  Nstates * sizeof(int));
+  SECTION(goto_,   Nstates * sizeof(int));
+  SECTION(lhs,     Num_productions * sizeof(int));
+  SECTION(reduce,  Num_productions * sizeof(int));
+  SECTION(stokoff, ntoks * sizeof(int));
+
+  /* the pool and the names are made first, then everything is copied into
+   * one buffer so that the checksum can be computed
+   */
+
+  if (!(offsets = (int *) mem_alloc(MEM_OUTPUT, 2 * Nstates * sizeof(int)))) {
+    error(FATAL, "no memory for %s\n", BIN_FILE);
+  }
+  Npool = 0;
+  pool_table(Actions, offsets);
+  pool_table(Gotos, offsets + Nstates);
+
+  hdr.npool = Npool;
+  SECTION(pool, Npool * sizeof(short));
+
+  for (i = 0; i < ntoks; ++i) {
+    tprintf(&strings, "%s", i ? Terms[MINTERM + i - 1]->name : "_EOI_");
+    ++strings.len;    /* keep the '\0' that tprintf() left there */
+  }
+  hdr.nstrings = strings.len;
+  SECTION(strings, strings.len);
+
+#undef SECTION
+
+  if (!(buf = (char *) mem_calloc(MEM_OUTPUT, hdr.size, 1))) {
+    error(FATAL, "no memory for %s\n", BIN_FILE);
+  }
+
+  memcpy(buf + hdr.action, offsets, Nstates * sizeof(int));
+  memcpy(buf + hdr.goto_, offsets + Nstates, Nstates * sizeof(int));
+  for (i = 0; i < Num_productions; ++i) {
+    ((int *) (buf + hdr.lhs))[i] = ADJ_VAL(prodtab[i]->lhs->val);
+    ((int *) (buf + hdr.reduce))[i] = prodtab[i]->rhs_len;
+  }
+  for (i = 0, q = (unsigned char *) strings.buf; i < ntoks; ++i) {
+    ((int *) (buf + hdr.stokoff))[i] = (char *) q - strings.buf;
+    q += strlen((char *) q) + 1;
+  }
+  memcpy(buf + hdr.pool, Pool, Npool * sizeof(short));
+  memcpy(buf + hdr.strings, strings.buf, strings.len);
+
+  for (q = (unsigned char *) buf + sizeof(hdr); q < (unsigned char *) buf + hdr.size; ++q) {
+    sum = (sum ^ *q) * 16777619U;
+  }
+  hdr.checksum = sum;
+  memcpy(buf, &hdr, sizeof(hdr));
+
+  if (Library) {    /* librbison.c takes it from here */
+    Tab_image = buf;
+    Tab_size = hdr.size;
+    buf = NULL;
+  } else if (!(fp = fopen(tmp_name, "wb"))) {
+    error(FATAL, "can't open %s\n", tmp_name);
+  } else if (fwrite(buf, 1, hdr.size, fp) != hdr.size || fclose(fp) != 0 || rename(tmp_name, BIN_FILE) != 0) {
+    remove(tmp_name);
+    error(FATAL, "can't write %s\n", BIN_FILE);
+  }
+
+  comment(Output, text);
+  output("#define YYTABNPRODS %d\n", Num_productions);
+
+  mem_free(buf);
+  mem_free(offsets);
+  mem_free(strings.buf);
+  mem_free(Pool);
+  Pool = NULL;
+  Max_pool = 0;
+}
+
+static void print_reductions()
+{
+  /* output the various tables needed to do reductions */
+  PRODUCTION **prodtab;
+
+  if (!(prodtab = (PRODUCTION**) mem_alloc(MEM_PRODS, sizeof(PRODUCTION *) * Num_productions))) {
+    error(FATAL, "no memory to output LALR(1) reduction tables\n");
   } else {
-    output("\nYY_TTYPE *%s[%d] = \n", col_name, Nstates);
+    ptab(Symtab, (ptab_t)mkprod, prodtab, 0);
   }
 
-  output("{");
+  if (Make_tabfile) {
+    write_tabfile(prodtab);
+  } else {
+    make_yy_lhs(prodtab);
+    make_yy_reduce(prodtab);
+  }
+  make_yy_prods(prodtab);
+  make_yy_needs(prodtab);
 
-  for (elep = table, i = 0; i < Nstates; i++, elep++) {
-    if (i == 0 || (i % 8) == 0) {
-      output("\n/* %3d */ ", i);
+  mem_free(prodtab);
+}
+
+static void make_ids()
+{
+  /* number the LR(0) items and make the tables that ITEM_PROD(), NEXT_SYM()
+   * and RIGHT_OF_DOT() use
+   */
+
+  PRODUCTION **prodtab, *prod;
+  int i, j, id;
+
+  if (!(prodtab = (PRODUCTION **) mem_alloc(MEM_PRODS, sizeof(PRODUCTION *) * Num_productions))
+        || !(Prod_base = (int *) mem_alloc(MEM_PRODS, sizeof(int) * Num_productions))) {
+    error(FATAL, "no memory for LR(0) items\n");
+  }
+  ptab(Symtab, (ptab_t)mkprod, prodtab, 0);
+
+  for (Nids = i = 0; i < Num_productions; ++i) {
+    Prod_base[i] = Nids;
+    Nids += prodtab[i]->rhs_len + 1;
+  }
+
+  if (!(Id_prod = (PRODUCTION **) mem_alloc(MEM_PRODS, sizeof(PRODUCTION *) * Nids))
+        || !(Id_sym = (SYMBOL **) mem_alloc(MEM_PRODS, sizeof(SYMBOL *) * Nids))
+        || !(Id_key = (int *) mem_alloc(MEM_PRODS, sizeof(int) * Nids))) {
+    error(FATAL, "no memory for LR(0) items\n");
+  }
+
+  for (Max_key = id = i = 0; i < Num_productions; ++i) {
+    prod = prodtab[i];
+    for (j = 0; j <= prod->rhs_len; ++j, ++id) {
+      Id_prod[id] = prod;
+      Id_sym[id] = j < prod->rhs_len ? prod->rhs[j] : NULL;
+      Id_key[id] = Id_sym[id] ? Id_sym[id]->val : 0;
+      Max_key = max(Max_key, Id_key[id]);
     }
-    if (MEMBER(redundant, i)) {
-      output("%s%03d", row_name, (int)(((ACT**)(*elep)) - table));
-    } else {
-      output(*elep ? "%s%03d" : " NULL", row_name, i);
+  }
+
+  mem_free(prodtab);
+}
+
+static int nworkers()
+{
+  /* the number of threads that'll work on states. -j without a number uses
+   * one per processor. -V output has to come out in order, so it gets one
+   * thread.
+   */
+
+  int n = Threads > 0 ? Threads : get_nprocs();
+
+  return Verbose > 1 ? 1 : min(max(n, 1), MAXTHREADS);
+}
+
+int lr_order()
+{
+  /* the order in which the states are really worked on, and so numbered.
+   * with more than one thread, they're closed in batches that are sorted
+   * by number whatever -q says (see lr_batches()), the same as -qn.
+   */
+
+  return nworkers() > 1 ? 'n' : Work_order;
+}
+
+static void make_workers()
+{
+  /* set up one WORKER for each thread that'll work on states */
+
+  int i;
+
+  Nworkers = nworkers();
+
+  if (!(Workers = (WORKER *) mem_calloc(MEM_LR, Nworkers, sizeof(WORKER)))) {
+    error(FATAL, "no memory for workers\n");
+  }
+
+  for (i = 0; i < Nworkers; ++i) {
+    Workers[i].closure_set = newset();
+    Workers[i].union_set = newset();
+    if (!(Workers[i].count = (int *) mem_alloc(MEM_LR, sizeof(int) * (Max_key + 2)))) {
+      error(FATAL, "no memory for workers\n");
     }
+  }
+}
 
-    if (i != Nstates - 1) {
-      output(", ");
+static void sort_items(WORKER *w, ITEM **items, int nitems)
+{
+  /* sort the items into item_cmp() order without calling qsort(). a counting
+   * sort on the symbol to the right of the dot puts them in the right groups,
+   * and the groups are short, so an insertion sort finishes the job. both
+   * sorts are stable.
+   */
+
+  int *count = w->count;
+  ITEM *item;
+  int i, j;
+
+  if (nitems > w->maxsorted) {
+    w->maxsorted = max(nitems, w->maxsorted * 2);
+    if (!(w->sorted = (ITEM **) mem_realloc(MEM_LR, w->sorted, w->maxsorted * sizeof(ITEM *)))) {
+      error(FATAL, "no memory for closure items\n");
     }
   }
-  output("\n};\n");
-  delset(redundant);
+
+  memset(count, 0, sizeof(int) * (Max_key + 2));
+  for (i = 0; i < nitems; ++i) {
+    ++count[RIGHT_OF_DOT(items[i]) + 1];
+  }
+  for (i = 1; i <= Max_key; ++i) {
+    count[i] += count[i - 1];   /* count[key] is where the key's group starts */
+  }
+  for (i = 0; i < nitems; ++i) {
+    w->sorted[count[RIGHT_OF_DOT(items[i])]++] = items[i];
+  }
+
+  for (i = 0; i < nitems; ++i) {
+    item = w->sorted[i];
+    for (j = i; j > 0 && item_cmp(&item, &items[j - 1]) < 0; --j) {
+      items[j] = items[j - 1];
+    }
+    items[j] = item;
+  }
 }
 
-static int lr(STATE *cur_state)
+typedef struct _job_ {          /* a state that's being closed */
+  STATE *state;
+  ITEM **closure_items;
+  int maxclose;                 /* size of closure_items */
+  int nclose;                   /* # of items in it */
+} JOB;
+
+static void close_state(WORKER *w, JOB *job)
 {
-  /* make LALR(1) state machine. the shifts and gotos are done here, the
-   * reductions are done elsewhere. return the number of states.
+  /* put the items that leave job->state into job->closure_items. this is
+   * the part of lr() that can be done for several states at once: it
+   * changes nothing outside of the worker and the job.
+   *
+   * closure()  adds normal closure items to closure_items array
+   * kclose()   adds to that set all items in the kernel that have
+   *            outgoing transitions (ie. whose dots aren't at the far
+   *            right)
+   * sort_items() sorts the closure items by the symbol to the right
+   *            of the dot. epsilon transitions will sort to the head of
+   *            the list, followed by transitions on terminals,
+   *            followed by transitions on nonterminals
    */
-  
+
+  STATE *cur_state = job->state;
+  int maxclose;
+  int nclose;
+
+  /* closure() adds each production at most once */
+
+  if ((maxclose = Num_productions + cur_state->nkitems) > job->maxclose) {
+    job->maxclose = maxclose;
+    if (!(job->closure_items = (ITEM **) mem_realloc(MEM_LR, job->closure_items, maxclose * sizeof(ITEM *)))) {
+      error(FATAL, "no memory for closure items\n");
+    }
+  }
+
+  nclose = closure(w, cur_state, job->closure_items, maxclose);
+  nclose = kclosure(w, cur_state, job->closure_items, maxclose, nclose);
+  sort_items(w, job->closure_items, nclose);
+  job->nclose = nclose;
+}
+
+static void goto_states(STATE *cur_state, ITEM **closure_items, int nclose, int *nlr)
+{
+  /* make (or find) the states that cur_state goes to, given the closure
+   * items made by close_state(), and add the transitions to them. 
+   * move_eps() moves the epsilon transitions into the closure kernel set.
+   * it returns the number of items that it moved
+   */
+
   ITEM **p;
   ITEM **first_item;
-  ITEM *closure_items[MAXCLOSE];
   STATE *next;  /* next state */
   int isnew;    /* next state is a new state */
-  int nclose;   /* number of items in closure_items */
   int nitems;   /* # items with same symbol to right of dot */
 
   int val;      /* value of symbol to right of dot */
   SYMBOL *sym;  /* actual symbol to right of dot */
 
-  int nlr = 0;  /* Nstates + nlr = number of LR(1) states */
+  p = closure_items;
 
-  add_unfinished(cur_state);
-  
-  while (cur_state = get_unfinished()) {
+  if (nclose == 0) {
     if (Verbose > 1) {
-      printf("next pass.. working on state %d\n", cur_state->num);
+      printf("there were no closure items added\n");
     }
+  } else {
+    nitems = move_eps(cur_state, closure_items, nclose);
+    p = closure_items + nitems;
+    nclose = nclose - nitems;
+    
+    if (Verbose > 1) {
+      pclosure(cur_state, p, nclose);
+    }
+  }
 
-    /* closure()  adds normal closure items to closure_items array
-     * kclose()   adds to that set all items in the kernel that have
-     *            outgoing transitions (ie. whose dots aren't at the far
-     *            right)
+  /* all of the remaining items have at least one symbol to the right of the dot */
+  while (nclose > 0) { /* fails immediatly if no closure items */
+    first_item = p;
+    sym = NEXT_SYM(*first_item);
+    val = sym->val;
 
-     * qsort()   sorts the closure items by the symbol to the right
-     *           of the dot. epsilon transitions will sort to the head of
-     *           the list, followed by transitions on nonterminals,
-     *           followed by transitions on terminals
-     * move_eps() moves the epsilon transitions into the closure kernel set.
-     *            it returns the number of items that it moved
+    /* collect all items with the same symbol to the right of the dot 
+     * on exiting the loop, nitems will hold the number of these items
+     * and p will point at the first nonmatching item. finally nclose is
+     * decremented by nitems. items = 0
      */
-    nclose = closure(cur_state, closure_items, MAXCLOSE);
-    nclose = kclosure(cur_state, closure_items, MAXCLOSE, nclose);
-    if (nclose == 0) {
-      if (Verbose > 1) {
-        printf("there were no closure items added\n");
+    nitems = 0;
+    do {
+      movedot(*p++);
+      ++nitems;
+    } while (--nclose > 0 && RIGHT_OF_DOT(*p) == val);
+
+    /* (1) newstate() gets the next state. it returns NEW if the state
+     *     didn't exist previously, CLOSED if LR(0) closure has been
+     *     performed on the state, UNCLOSED otherwise.
+     * (2) add a transition from the current state to the next state.
+     * (3) if it's a brand-new state, add it to the unfinished list.
+     * (4) otherwise merge the lookaheads created by the current closure
+     *     operation with the ones already in the state.
+     * (5) if the merge operation added lookaheads to the existing set,
+     *     add it to the unfinished list.
+     */
+    
+    isnew = newstate(first_item, nitems, &next); /* (1) */
+    if (!cur_state->closed) { /* (2) */
+      if (ISTERM(sym)) {
+        add_action(Workers, cur_state->num, val, next->num);
+      } else {
+        add_goto(Workers, cur_state->num, val, next->num);
       }
+    }
+    
+    if (isnew == NEW) { 
+      add_unfinished(next); /* (3) */
     } else {
-      qsort(closure_items, nclose, sizeof(ITEM *), item_cmp);
-      nitems = move_eps(cur_state, closure_items, nclose);
-      p = closure_items + nitems;
-      nclose = nclose - nitems;
-      
-      if (Verbose > 1) {
-        pclosure(cur_state, p, nclose);
+      if (merge_lookaheads(next->kernel_items, first_item, nitems)) { /* (4) */
+        add_unfinished(next); /* (5) */
+        ++*nlr;
       }
     }
+    
+    if (!Library) {
+      fprintf(stderr, "\rLR:%-3d LALR:%-3d", Nstates + *nlr, Nstates);
+    }
+  }
+  cur_state->closed = 1;
+}
 
-    /* all of the remaining items have at least one symbol to the right of the dot */
-    while (nclose > 0) { /* fails immediatly if no closure items */
-      first_item = p;
-      sym = (*first_item)->right_of_dot;
-      val = sym->val;
 
-      /* collect all items with the same symbol to the right of the dot 
-       * on exiting the loop, nitems will hold the number of these items
-       * and p will point at the first nonmatching item. finally nclose is
-       * decremented by nitems. items = 0
-       */
-      nitems = 0;
-      do {
-        movedot(*p++);
-        ++nitems;
-      } while (--nclose > 0 && RIGHT_OF_DOT(*p) == val);
-
-      /* (1) newstate() gets the next state. it returns NEW if the state
-       *     didn't exist previously, CLOSED if LR(0) closure has been
-       *     performed on the state, UNCLOSED otherwise.
-       * (2) add a transition from the current state to the next state.
-       * (3) if it's a brand-new state, add it to the unfinished list.
-       * (4) otherwise merge the lookaheads created by the current closure
-       *     operation with the ones already in the state.
-       * (5) if the merge operation added lookaheads to the existing set,
-       *     add it to the unfinished list.
-       */
-      
-      isnew = newstate(first_item, nitems, &next); /* (1) */
-      if (!cur_state->closed) { /* (2) */
-        if (ISTERM(sym)) {
-          add_action(cur_state->num, val, next->num);
-        } else {
-          add_goto(cur_state->num, val, next->num);
-        }
+static JOB *Jobs = NULL;          /* the current batch of states */
+static int Max_jobs = 0;
+
+static int job_cmp(const void *job1p, const void *job2p)
+{
+  return ((JOB *) job1p)->state->num - ((JOB *) job2p)->state->num;
+}
+
+static void close_job(WORKER *w, int i)
+{
+  close_state(w, &Jobs[i]);
+}
+
+static void lr_batches(int *nlr)
+{
+  /* the -j version of lr()'s loop. all of the unfinished states are taken
+   * at once and closed by Nworkers threads. then the states they go to are
+   * made by a single thread, in state-number order. states are only numbered
+   * in that second step, and a state is always closed for the first time
+   * in state-number order, so the states get the same numbers that they do
+   * when they're made one at a time. the lookaheads are propagated in a
+   * different order, but they end up the same: a state stays unfinished
+   * until nothing more can be added to it.
+   *
+   * a batch can hold any number of states. the threads take them from
+   * parallel_for()'s shared counter rather than stealing work from each
+   * other, closing a state costs far more than taking Par_lock. making the
+   * successors and merging their lookaheads stays serial, so the state
+   * table doesn't have to be safe to change from several threads.
+   */
+
+  STATE *state;
+  int i, njobs;
+
+  while (Npending) {
+    if (Npending > (i = Max_jobs)) {  /* the closure_items of the old jobs are reused */
+      if (!(Jobs = (JOB *) mem_realloc(MEM_LR, Jobs, (Max_jobs = Npending * 2) * sizeof(JOB)))) {
+        error(FATAL, "no memory for unfinished states\n");
       }
-      
-      if (isnew == NEW) { 
-        add_unfinished(next); /* (3) */
-      } else {
-        if (merge_lookaheads(next->kernel_items, first_item, nitems)) { /* (4) */
-          add_unfinished(next); /* (5) */
-          ++nlr;
-        }
-        while (--nitems >= 0) {
-          freeitem(*first_item++);
-        }
+      memset(Jobs + i, 0, (Max_jobs - i) * sizeof(JOB));
+    }
+
+    for (njobs = 0; (state = get_unfinished()); ) {
+      Jobs[njobs++].state = state;
+    }
+    if (Work_order != 'n') {  /* -q doesn't matter here */
+      qsort(Jobs, njobs, sizeof(JOB), job_cmp);
+    }
+
+    for (i = 0; i < Nworkers; ++i) {
+      arena_reset(&Workers[i].scratch);
+    }
+
+    parallel_for(njobs, 1, close_job);
+
+    for (i = 0; i < njobs; ++i) {
+      goto_states(Jobs[i].state, Jobs[i].closure_items, Jobs[i].nclose, nlr);
+    }
+  }
+}
+
+static int lr(STATE *cur_state)
+{
+  /* make LALR(1) state machine. the shifts and gotos are done here, the
+   * reductions are done elsewhere. return the number of states.
+   */
+  
+  JOB job;      /* the state being worked on and its closure items */
+  int nlr = 0;  /* Nstates + nlr = number of LR(1) states */
+
+  memset(&job, 0, sizeof(job));
+
+  add_unfinished(cur_state);
+
+  if (Nworkers > 1) {
+    lr_batches(&nlr);
+  } else {
+    while (cur_state = get_unfinished()) {
+      arena_reset(&Workers->scratch);  /* the last state's closure items aren't needed */
+
+      if (Verbose > 1) {
+        printf("next pass.. working on state %d\n", cur_state->num);
       }
-      
-      fprintf(stderr, "\rLR:%-3d LALR:%-3d", Nstates + nlr, Nstates);
+
+      job.state = cur_state;
+      close_state(Workers, &job);
+      goto_states(cur_state, job.closure_items, job.nclose, &nlr);
     }
-    cur_state->closed = 1;
+    mem_free(job.closure_items);
   }
 
-  free_recycled_items();
   if (Verbose) {
-    fprintf(stderr, "states, %d items, %d shift and goto transitions\n", Nitems, Ntab_entries);
+    fprintf(stderr, "states, %d items, %d shift and goto transitions\n", Nitems, tab_entries());
   }
 
   return Nstates;
@@ -1327,7 +2430,7 @@ static int lr(STATE *cur_state)
 
 static int state_cmp(STATE *new, STATE *tab_node)
 {
-  /* new: pointer to new node (ignored if Sort_by_number is false)
+  /* new: pointer to new node (ignored, the new state is in State_items)
    * tab_node: pointer to existing node
    */
   
@@ -1335,58 +2438,244 @@ static int state_cmp(STATE *new, STATE *tab_node)
    * the relative weight of the states, or 0 of the states are equivalent.
    */
   
-  ITEM **tab_item; /* array of items for existing state */
-  ITEM **item;     /* array of items for new state */
-  int nitem;
   int cmp;
 
-  if (Sort_by_number) {
-    return (new->num - tab_node->num);
-  }
-
-
   if (cmp = State_nitems - tab_node->nkitems) { /* state with largest number of items is larger */
     return cmp;
   }
 
-  nitem = State_nitems;
-  item = State_items;
+  return memcmp(State_ids, tab_node->kernel, State_nitems * sizeof(int));
+}
 
-  tab_item = tab_node->kernel_items;
 
-  for (; --nitem >= 0; ++tab_item, ++item) {
-    if (cmp = (*item)->prod_num - (*tab_item)->prod_num) {
-      return cmp;
+static unsigned int state_hash(STATE *sym)
+{
+  /* hash function for STATEs. the hash of the kernel being looked up was
+   * computed by newstate(), sym is ignored.
+   */
+
+  return State_hash;
+}
+
+static void save_tables()
+{
+  /* hand the finished action and goto tables, along with the conflict log,
+   * to the cache (see yycache.c). the rows are saved in order so that
+   * load_tables() can rebuild them exactly.
+   */
+
+  ROW *table;
+  ACT *p;
+  int i;
+  CONFLICT *c;
+
+  cache_put(Nstates);
+
+  for (table = Actions; table; table = (table == Actions) ? Gotos : NULL) {
+    for (i = 0; i < Nstates; ++i) {
+      cache_put(table[i].nacts);
+      for (p = table[i].acts; p < table[i].acts + table[i].nacts; ++p) {
+        cache_put(p->sym);
+        cache_put(p->do_this);
+      }
     }
+  }
 
-    if (cmp = (*item)->dot_posn - (*tab_item)->dot_posn) {
-      return cmp;
+  cache_put(Conflicts.nconflicts);
+  for (c = Conflicts.conflicts, i = Conflicts.nconflicts; --i >= 0; ++c) {
+    cache_put(c->state);
+    cache_put(c->token);
+    cache_put(c->prod);
+    cache_put(c->other);
+    cache_put(c->choice);
+    cache_put(c->resolved);
+  }
+
+  cache_save();
+}
+
+static void load_tables()
+{
+  /* the reverse of save_tables(): rebuild the action and goto tables from the
+   * cache, and print the conflict warnings that building them printed.
+   */
+
+  ROW *table;
+  int i, n, ncols, sym, state, token, prod, other, choice;
+
+  if ((Nstates = cache_get()) <= 0) {
+    error(FATAL, "%s is damaged, remove it and try again\n", CACHE_FILE);
+  }
+  grow_states(Nstates);
+
+  for (table = Actions; table; table = (table == Actions) ? Gotos : NULL) {
+    ncols = (table == Actions) ? ACTION_COLS : GOTO_COLS;
+    for (i = 0; i < Nstates; ++i) {
+      for (n = cache_get(); --n >= 0; ) {
+        if ((sym = cache_get()) < 0 || sym >= ncols || row_find(&table[i], sym)) {
+          error(FATAL, "%s is damaged, remove it and try again\n", CACHE_FILE);
+        }
+        row_add(Workers, &table[i], ncols, sym, cache_get());
+      }
     }
   }
 
-  return 0; /* states are equivalent */
+  for (n = cache_get(); --n >= 0; ) {
+    state  = cache_get();
+    token  = cache_get();
+    prod   = cache_get();
+    other  = cache_get();
+    choice = cache_get();
+    pconflict(add_conflict(&Conflicts, state, token, prod, other, choice, cache_get()));
+  }
 }
 
+typedef struct _ranked_ {     /* an ACT and how often it was looked up */
+  long n;
+  int pos;                    /* its index in the row */
+  ACT act;
+} RANKED;
 
-static unsigned int state_hash(STATE *sym)
+static int ranked_cmp(const void *p1, const void *p2)
+{
+  const RANKED *r1 = (const RANKED *) p1, *r2 = (const RANKED *) p2;
+
+  if (r1->n != r2->n) {
+    return r1->n < r2->n ? -1 : 1;
+  }
+  return r1->pos - r2->pos;
+}
+
+static void order_row(ROW *row, int state, int is_action)
+{
+  /* put the ACTs of the row in the order of the profile's counts for them.
+   * the rows are printed backwards, so the most used ACT goes last. ACTs
+   * with the same count keep their order.
+   */
+
+  RANKED *ranked;
+  long total = 0;
+  int k;
+
+  if (!row->nacts) {
+    return;
+  }
+  if (!(ranked = (RANKED *) mem_alloc(MEM_OUTPUT, row->nacts * sizeof(RANKED)))) {
+    error(FATAL, "no memory to order the tables\n");
+  }
+
+  for (k = 0; k < row->nacts; ++k) {
+    ranked[k].act = row->acts[k];
+    ranked[k].pos = k;
+    ranked[k].n = is_action ? prof_action(state, row->acts[k].sym)
+                            : prof_goto(state, row->acts[k].sym);
+    total += ranked[k].n;
+  }
+
+  if (total) {
+    qsort(ranked, row->nacts, sizeof(RANKED), ranked_cmp);
+    for (k = 0; k < row->nacts; ++k) {
+      row->acts[k] = ranked[k].act;
+    }
+  }
+  mem_free(ranked);
+}
+
+static int heat_cmp(const void *p1, const void *p2)
 {
-  /* hash function for STATEs. mum together production numbers and dot
-   * positions of the kernel items.
+  /* busiest state first, then by state number */
+
+  int s1 = *(const int *) p1, s2 = *(const int *) p2;
+  long h1 = prof_state(s1), h2 = prof_state(s2);
+
+  if (h1 != h2) {
+    return h1 < h2 ? 1 : -1;
+  }
+  return s1 - s2;
+}
+
+static void use_profile()
+{
+  /* order the pairs in each row by the profile's counts, then renumber the
+   * states so that the busiest ones come first and their rows end up next
+   * to each other in the parser. the start state has to stay 0. the states
+   * in y.output, the conflict messages and y.cache keep their old numbers.
    */
-  ITEM **items;   /* array of items for new state */
-  int nitems;     /* size of */
 
-  unsigned int total;
+  int *new_num, i;
+  ROW *table, *rows;
+  ACT *p;
 
-  items = State_items;
-  nitems = State_nitems;
-  total = 0;
+  for (i = 0; i < Nstates; ++i) {
+    order_row(&Actions[i], i, 1);
+    order_row(&Gotos[i], i, 0);
+  }
 
-  for (; --nitems >= 0; ++items) {
-    total += (*items)->prod_num + (*items)->dot_posn; 
+  if (!(Natural = (int *) mem_alloc(MEM_TABLES, Nstates * sizeof(int)))
+        || !(new_num = (int *) mem_alloc(MEM_OUTPUT, Nstates * sizeof(int)))
+        || !(rows = (ROW *) mem_alloc(MEM_OUTPUT, Nstates * sizeof(ROW)))) {
+    error(FATAL, "no memory to renumber the states\n");
   }
 
-  return total;
+  for (i = 0; i < Nstates; ++i) {
+    Natural[i] = i;
+  }
+  qsort(Natural + 1, Nstates - 1, sizeof(int), heat_cmp);
+
+  for (i = 0; i < Nstates; ++i) {
+    new_num[Natural[i]] = i;
+  }
+
+  for (table = Actions; table; table = (table == Actions) ? Gotos : NULL) {
+    for (i = 0; i < Nstates; ++i) {
+      rows[i] = table[Natural[i]];
+      for (p = rows[i].acts; p < rows[i].acts + rows[i].nacts; ++p) {
+        if (table == Gotos || p->do_this > 0) {
+          p->do_this = new_num[p->do_this];
+        }
+      }
+    }
+    memcpy(table, rows, Nstates * sizeof(ROW));
+  }
+
+  mem_free(rows);
+  mem_free(new_num);
+}
+
+void reset_lr()
+{
+  /* forget the states and tables of the last grammar. librbison.c calls
+   * this after it's freed their memory with mem_release(), before it makes
+   * the next one.
+   */
+
+  States = NULL;
+  Statev = NULL;
+  Nstates = Max_states = 0;
+  Actions = Gotos = NULL;
+  Nitems = Npairs = Nrows = 0;
+  Shift_reduce = Reduce_reduce = 0;
+  memset(&Conflicts, 0, sizeof(Conflicts));
+  Profiled = Nact = Ntext = Nplace = 0;
+  Natural = NULL;
+
+  Pending = NULL;
+  Npending = Low = 0;
+  Work = NULL;
+  Work_head = Work_max = 0;
+  Max_pending = Nrevisits = 0;
+  State_ids = NULL;
+  Max_ids = 0;
+
+  memset(&Items, 0, sizeof(Items));
+  Workers = NULL;
+  Nworkers = 0;
+  Jobs = NULL;
+  Max_jobs = 0;
+  Pool = NULL;
+  Npool = Max_pool = 0;
+  Item_buf = NULL;
+  Item_size = 0;
 }
 
 void make_parse_tables()
@@ -1397,6 +2686,7 @@ void make_parse_tables()
   
   ITEM *item;
   STATE *state;
+  SET *lookaheads;
   PRODUCTION *start_prod;
   FILE *fp, *old_output;
 
@@ -1416,63 +2706,178 @@ void make_parse_tables()
     error(FATAL, "start symbol must have only one right-hand side\n");
   }
 
-  item = newitem(start_prod);         /* make item for start production */
-  ADD(item->lookaheads, _EOI_);       /* end-of-input marker as a lookahead symbol */
-  ADD(item->lookaheads, WHITESPACE);  /* whitespace marker as a lookahead symbol */
+  stats_start(PH_LR);
+
+  if (cache_hit()) {
+    make_workers();
+    load_tables();  /* the grammar is unchanged, use the old tables */
+    free_cols();
+    stats_stop(PH_LR);
+  } else {
+    make_ids();
+    make_workers();
+
+    lookaheads = newset();
+    No_lookaheads = intern(lookaheads);
+
+    ADD(lookaheads, _EOI_);             /* end-of-input marker as a lookahead symbol */
+    ADD(lookaheads, WHITESPACE);        /* whitespace marker as a lookahead symbol */
+    item = newitem(Workers, start_prod); /* make item for start production */
+    item->lookaheads = intern(lookaheads);
+    delset(lookaheads);
   
-  newstate(&item, 1, &state);
-  if (lr(state)) {  /* add shifts and gotos to the table */
+    newstate(&item, 1, &state);
+    if (!lr(state)) { /* add shifts and gotos to the table */
+      stats_stop(PH_LR);
+      return;
+    }
+    stats_stop(PH_LR);
+
     if (Verbose) {
       printf("adding reductions:\n");
     }
     
-    reductions(); /* add the reductions */
-    
-    if (Verbose) {
-      printf("creating tables:\n");
-    }
+    stats_start(PH_REDUCE);
+    reductions();   /* add the reductions */
+    free_cols();
+    stats_stop(PH_REDUCE);
+
+    stats_start(PH_TABLES);
+    save_tables();  /* for next time (-c) */
+    stats_stop(PH_TABLES);
+  }
+
+  if (Verbose) {
+    printf("creating tables:\n");
+  }
+
+  stats_start(PH_TABLES);
+
+  if ((Profiled = prof_load(Nstates))) {
+    use_profile();
+  }
+
+  if (Make_tabfile) {   /* tables go in y.tab.bin, see print_reductions() */
+    ;
+  } else if (!Make_yyoutab) {  /* tables go in y.tab.c */
+    print_tab(Actions, "Yya", "Yy_action", 1);
+    print_tab(Gotos, "Yyg", "Yy_goto", 1);
+  } else { /* tables go in y.outab.c*/
 
-    if (!Make_yyoutab) {  /* tables go in y.tab.c */
+    if (!(fp = fopen(TAB_FILE, "w"))) {
+      error(NONFATAL, "can't open %s ignoring -T\n", TAB_FILE);
       print_tab(Actions, "Yya", "Yy_action", 1);
       print_tab(Gotos, "Yyg", "Yy_goto", 1);
-    } else { /* tables go in y.outab.c*/
+    } else {
+      output("extern YY_TTYPE *Yy_action[]; /* in y.outab.c */\n");
+      output("extern YY_TTYPE *Yy_goto[];   /* in y.outab.c */\n");
+      old_output = Output;
+      Output = fp;
+      fprintf(fp, "#include <stdio.h>\n");
+      fprintf(fp, "typedef short YY_TTYPE;\n");
+      fprintf(fp, "#define YYPRIVATE %s\n", Public ? "/* empty */" : "static");
+
+      print_tab(Actions, "Yya", "Yy_action", 0);
+      print_tab(Gotos, "Yyg", "Yy_goto", 0);
+      fclose(fp);
+      Output = old_output;
+    }
+  }
+  print_reductions();
+  stats_stop(PH_TABLES);
+}
 
-      if (!(fp = fopen(TAB_FILE, "w"))) {
-        error(NONFATAL, "can't open %s ignoring -T\n", TAB_FILE);
-        print_tab(Actions, "Yya", "Yy_action", 1);
-        print_tab(Gotos, "Yyg", "Yy_goto", 1);
-      } else {
-        output("extern YY_TTYPE *Yy_action[]; /* in y.outab.c */\n");
-        output("extern YY_TTYPE *Yy_goto[];   /* in y.outab.c */\n");
-        old_output = Output;
-        Output = fp;
-        fprintf(fp, "#include <stdio.h>\n");
-        fprintf(fp, "typedef short YY_TTYPE;\n");
-        fprintf(fp, "#define YYPRIVATE %s\n", Public ? "/* empty */" : "static");
-
-        print_tab(Actions, "Yya", "Yy_action", 0);
-        print_tab(Gotos, "Yyg", "Yy_goto", 0);
-        fclose(fp);
-        Output = old_output;
-      }
+static unsigned int *Hashes;    /* used by get_hash() */
+static int Nhashes;
+
+static void get_hash(STATE *state, void *junk)
+{
+  Hashes[Nhashes++] = state->hash;
+}
+
+static int uint_cmp(const void *p1, const void *p2)
+{
+  unsigned int a = *(unsigned int *) p1, b = *(unsigned int *) p2;
+  return a < b ? -1 : a > b;
+}
+
+static void hash_stats(FILE *fp)
+{
+  /* print statistics about the state hash table: how far findsym() had to
+   * look, and how many states have the same hash value as another state.
+   */
+
+  int i, shared = 0;
+
+  if (!States || !(Hashes = (unsigned int *) mem_alloc(MEM_LR, (States->numsyms + 1) * sizeof(unsigned int)))) {
+    return;
+  }
+
+  Nhashes = 0;
+  ptab(States, (ptab_t)get_hash, NULL, 0);
+  qsort(Hashes, Nhashes, sizeof(unsigned int), uint_cmp);
+
+  for (i = 0; i < Nhashes; ++i) {
+    if ((i > 0 && Hashes[i] == Hashes[i - 1]) || (i < Nhashes - 1 && Hashes[i] == Hashes[i + 1])) {
+      ++shared;
     }
-    print_reductions();
   }
+  mem_free(Hashes);
+
+  fprintf(fp, "%4ld  state lookups, %.2f slots probed and %.2f states compared per lookup\n",
+        States->lookups,
+        States->lookups ? (double) States->probes / States->lookups : 0.0,
+        States->lookups ? (double) States->compares / States->lookups : 0.0);
+  fprintf(fp, "%4d  states share a hash value with another state\n", shared);
+  fprintf(fp, "      slots probed per lookup:");
+  for (i = 0; i < HASH_HIST; ++i) {
+    fprintf(fp, " %d%s=%ld", i, i == HASH_HIST - 1 ? "+" : "", States->hist[i]);
+  }
+  fprintf(fp, "\n");
+}
+
+static long table_bytes()
+{
+  /* the size of the tables printed by print_tab(), in the parser. YY_TTYPE
+   * is a short there.
+   */
+
+  return 2 * Nstates * sizeof(short *)        /* Yy_action and Yy_goto */
+        + Nrows * sizeof(short)               /* count fields */
+        + 2 * Npairs * sizeof(short);         /* pairs */
 }
 
 void lr_stats(FILE *fp)
 {
   /*  print out various statistics about the table-making process */
+
+  long lookups, hits, bytes;
+  int nsets, i;
+
+  bytes = Items.size;
+  for (i = 0; i < Nworkers; ++i) {
+    bytes += Workers[i].scratch.size;
+  }
+
   fprintf(fp, "%4d  LALR(1) states\n", Nstates);
-  fprintf(fp, "%4d  items\n", Nitems);
-  fprintf(fp, "%4d  nonerror transitions in tables\n", Ntab_entries);
-  fprintf(fp, "%4ld/%-4d unfinished items\n", (long)(Next_allocate - Heap), MAX_UNFINISHED);
-
-  fprintf(fp, "%4d bytes required for LALR(1) transition matrix\n", 
-        (2 * sizeof(int*) * Nstates)   /* index arrays */ 
-        + Nstates                      /* count fields */
-        + (Npairs *sizeof(short)));    /* pairs */
-  
+  fprintf(fp, "%4d  items, %ld bytes of item arenas\n", Nitems, bytes);
+
+  intern_stats(&lookups, &hits, &nsets, &bytes);
+  fprintf(fp, "%4d  distinct lookahead sets (%ld bytes), %ld of %ld interned sets already existed (%.1f%%)\n",
+        nsets, bytes, hits, lookups, lookups ? 100.0 * hits / lookups : 0.0);
+  fprintf(fp, "%4d  nonerror transitions in tables\n", tab_entries());
+  fprintf(fp, "%4d  states unfinished at most, %d states worked on again (-q%c)\n",
+        Max_pending, Nrevisits, Work_order);
+
+  fprintf(fp, "%4ld bytes required for LALR(1) transition matrix\n", table_bytes());
+
+  fprintf(fp, "%4d  of %d productions have actions, %d of them use yytext\n", Nact, Num_productions, Ntext);
+  fprintf(fp, "%4d  productions make $$ in place\n", Nplace);
+  if (Profiled) {
+    fprintf(fp, "      tables ordered by %s\n", Profile_file);
+  }
+
+  hash_stats(fp);
   fprintf(fp, "\n");
 }
 
@@ -1487,4 +2892,61 @@ int lr_conflicts(FILE *fp)
   fprintf(fp, "%4d  reduce/reduce conflicts\n", Reduce_reduce);
 
   return Shift_reduce + Reduce_reduce; 
-}
\ No newline at end of file
+}
+
+void lr_counters()
+{
+  /* hand the statistics of the table-making process to --stats */
+
+  long lookups, hits, bytes;
+  long closures = 0, do_close = 0, merges = 0, changed = 0;
+  long tests = 0, ops = 0, made = 0, recycled = 0;
+  int nsets;
+  WORKER *w;
+
+  for (w = Workers; w < Workers + Nworkers; ++w) {
+    closures += w->nclosures;
+    do_close += w->ndo_close;
+    merges   += w->nmerges;
+    changed  += w->nchanged;
+    tests    += w->nset_tests;
+    ops      += w->nset_ops;
+    made     += w->scratch.made;
+    recycled += w->scratch.recycled;
+  }
+
+  stats_count("states",            Nstates);
+  stats_count("items",             Nitems);
+  stats_count("closures",          closures);
+  stats_count("do_close_calls",    do_close);
+  stats_count("closure_items",     made);
+  stats_count("items_recycled",    recycled);
+  stats_count("la_merges",         merges);
+  stats_count("la_merges_changed", changed);
+  stats_count("set_tests",         tests);
+  stats_count("set_ops",           ops);
+
+  intern_stats(&lookups, &hits, &nsets, &bytes);
+  stats_count("intern_lookups",    lookups);
+  stats_count("intern_hits",       hits);
+  stats_count("lookahead_sets",    nsets);
+
+  if (States) {
+    stats_count("state_lookups",   States->lookups);
+    stats_count("state_probes",    States->probes);
+    stats_count("state_compares",  States->compares);
+  }
+  stats_count("symbol_lookups",    Symtab->lookups);
+  stats_count("symbol_probes",     Symtab->probes);
+
+  stats_count("max_pending",       Max_pending);
+  stats_count("revisits",          Nrevisits);
+  stats_count("transitions",       tab_entries());
+  stats_count("conflicts",         Shift_reduce + Reduce_reduce);
+  stats_count("table_rows",        Nrows);
+  stats_count("table_pairs",       Npairs);
+  stats_count("table_bytes",       table_bytes());
+  stats_count("actions",           Nact);
+  stats_count("text_actions",      Ntext);
+  stats_count("in_place",          Nplace);
+}
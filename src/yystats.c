@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <compiler.h>
+#include "parser.h"
+
+/*
+ * yystats.c: the timings and counters printed by --stats.
+ *
+ * do_file() and make_parse_tables() bracket each phase of the run with
+ * stats_start() and stats_stop(). a phase can be started more than once, the
+ * times add up. the counters are handed over with stats_count() once the work
+ * is done, mostly by lr_counters() (yystate.c), and printed in the order in
+ * which they were handed over. --stats prints a table to standard error,
+ * --stats=json prints the same thing as one JSON object.
+ *
+ * the CPU times are for the whole process, so with -j they include the time
+ * used by every thread and can be larger than the wall-clock times.
+ *
+ * the memory that rbison allocates is charged to categories (see
+ * lib/memory.c and the MEM_ names in parser.h). --stats also prints the
+ * memory in use at the end of each phase and the most that was in use while
+ * it ran, and print_memory() prints the use of each category (-v prints that
+ * too).
+ */
+
+static char *Phase_names[NPHASES] = {
+  "parse",        /* PH_PARSE:  reading the input file */
+  "first",        /* PH_FIRST:  FIRST sets and the -c cache lookup */
+  "patch",        /* PH_PATCH:  code_header() and patch(), the actions */
+  "lr",           /* PH_LR:     the LALR(1) states, or reading y.cache */
+  "reductions",   /* PH_REDUCE: adding the reductions */
+  "tables",       /* PH_TABLES: printing the tables, writing y.cache */
+  "driver",       /* PH_DRIVER: copying the driver and the tail of the input */
+};
+
+typedef struct _timing_ {
+  double wall, cpu;           /* total ms spent in the phase */
+  double wall0, cpu0;         /* when it was started */
+  long mem;                   /* bytes in use when it last stopped */
+  long peak;                  /* most bytes in use while it ran */
+} TIMING;
+
+static TIMING Phases[NPHASES];
+static TIMING Total;
+
+#define MAXCOUNTERS 64
+
+static struct {
+  char *name;
+  long value;
+} Counters[MAXCOUNTERS];
+
+static int Ncounters = 0;
+
+static struct {
+  int cat;
+  char *name;
+} Mem_names[] = {
+  { MEM_PRODS,   "productions" },
+  { MEM_ACTIONS, "actions"     },
+  { MEM_ITEMS,   "items"       },
+  { MEM_STATES,  "states"      },
+  { MEM_TABLES,  "table rows"  },
+  { MEM_LR,      "lr buffers"  },
+  { MEM_OUTPUT,  "output"      },
+};
+
+void init_stats()
+{
+  /* name the memory categories */
+
+  int i;
+
+  for (i = 0; i < NUMELE(Mem_names); ++i) {
+    mem_name(Mem_names[i].cat, Mem_names[i].name);
+  }
+}
+
+static double ms(clockid_t clock)
+{
+  struct timespec ts;
+
+  clock_gettime(clock, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+void stats_start(int phase)
+{
+  /* start timing a phase. Total is started by the first call */
+
+  TIMING *t = &Phases[phase];
+
+  if (!Stats) {
+    return;
+  }
+
+  t->wall0 = ms(CLOCK_MONOTONIC);
+  t->cpu0  = ms(CLOCK_PROCESS_CPUTIME_ID);
+  mem_mark();
+
+  if (!Total.wall0) {
+    Total.wall0 = t->wall0;
+    Total.cpu0  = t->cpu0;
+  }
+}
+
+void stats_stop(int phase)
+{
+  TIMING *t = &Phases[phase];
+
+  if (!Stats) {
+    return;
+  }
+
+  t->wall += ms(CLOCK_MONOTONIC) - t->wall0;
+  t->cpu  += ms(CLOCK_PROCESS_CPUTIME_ID) - t->cpu0;
+  t->peak  = max(t->peak, mem_mark_peak());
+  t->mem   = mem_mark();
+}
+
+void stats_count(char *name, long value)
+{
+  /* record a counter. name must be a string constant */
+
+  if (Stats && Ncounters < MAXCOUNTERS) {
+    Counters[Ncounters].name = name;
+    Counters[Ncounters++].value = value;
+  }
+}
+
+void print_memory(FILE *fp)
+{
+  /* print the memory use of each category that was used */
+
+  char *name;
+  long cur, peak, nallocs;
+  int cat;
+
+  fprintf(fp, "%-20s %12s %12s %12s\n", "memory", "in use", "peak", "allocations");
+  for (cat = 0; cat < MEM_MAXCAT; ++cat) {
+    if (mem_stats(cat, &name, &cur, &peak, &nallocs) && nallocs) {
+      fprintf(fp, "%-20s %12ld %12ld %12ld\n", name, cur, peak, nallocs);
+    }
+  }
+  mem_stats(MEM_TOTAL, &name, &cur, &peak, &nallocs);
+  fprintf(fp, "%-20s %12ld %12ld %12ld\n", "total", cur, peak, nallocs);
+}
+
+void print_stats(FILE *fp)
+{
+  /* print the timings and the counters, in the form chosen by --stats */
+
+  struct rusage ru;
+  long rss, cur, peak, nallocs;
+  char *name;
+  int i, cat;
+
+  if (!Stats) {
+    return;
+  }
+
+  Total.wall = ms(CLOCK_MONOTONIC) - Total.wall0;
+  Total.cpu  = ms(CLOCK_PROCESS_CPUTIME_ID) - Total.cpu0;
+  getrusage(RUSAGE_SELF, &ru);
+  rss = ru.ru_maxrss;
+
+  fprintf(fp, "\n");    /* the LR: progress line doesn't end with one */
+
+  if (Stats == STATS_JSON) {
+    fprintf(fp, "{\"phases\": {");
+    for (i = 0; i < NPHASES; ++i) {
+      fprintf(fp, "%s\"%s\": {\"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"mem_bytes\": %ld, \"peak_bytes\": %ld}",
+              i ? ",\n            " : "", Phase_names[i], Phases[i].wall, Phases[i].cpu,
+              Phases[i].mem, Phases[i].peak);
+    }
+    fprintf(fp, "},\n \"total\": {\"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"max_rss_kb\": %ld},\n",
+            Total.wall, Total.cpu, rss);
+
+    fprintf(fp, " \"counters\": {");
+    for (i = 0; i < Ncounters; ++i) {
+      fprintf(fp, "%s\"%s\": %ld", !i ? "" : i % 4 ? ", " : ",\n              ",
+              Counters[i].name, Counters[i].value);
+    }
+    fprintf(fp, "},\n \"memory\": {");
+    for (cat = 0; cat < MEM_MAXCAT; ++cat) {
+      if (mem_stats(cat, &name, &cur, &peak, &nallocs) && nallocs) {
+        fprintf(fp, "\"%s\": {\"bytes\": %ld, \"peak_bytes\": %ld, \"allocations\": %ld},\n            ",
+                name, cur, peak, nallocs);
+      }
+    }
+    mem_stats(MEM_TOTAL, &name, &cur, &peak, &nallocs);
+    fprintf(fp, "\"total\": {\"bytes\": %ld, \"peak_bytes\": %ld, \"allocations\": %ld}}}\n",
+            cur, peak, nallocs);
+    return;
+  }
+
+  fprintf(fp, "%-20s %12s %12s %6s %12s %12s\n", "phase", "wall ms", "cpu ms", "wall%",
+          "mem bytes", "peak bytes");
+  for (i = 0; i < NPHASES; ++i) {
+    fprintf(fp, "%-20s %12.3f %12.3f %5.1f%% %12ld %12ld\n", Phase_names[i], Phases[i].wall, Phases[i].cpu,
+            Total.wall > 0 ? 100.0 * Phases[i].wall / Total.wall : 0.0, Phases[i].mem, Phases[i].peak);
+  }
+  fprintf(fp, "%-20s %12.3f %12.3f\n", "total", Total.wall, Total.cpu);
+  fprintf(fp, "%-20s %12ld\n", "max rss kb", rss);
+
+  fprintf(fp, "\n%-20s %12s\n", "counter", "value");
+  for (i = 0; i < Ncounters; ++i) {
+    fprintf(fp, "%-20s %12ld\n", Counters[i].name, Counters[i].value);
+  }
+
+  fprintf(fp, "\n");
+  print_memory(fp);
+}
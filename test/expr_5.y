@@ -36,6 +36,17 @@ e : e PLUS e  { $$ = newast('+', $1, $3); }
   ;
 
 %%
+
+/* compiled with -DYYARENA, the nodes come from the parser's arena, and each
+ * parse frees the tree that the last one built
+ */
+
+#ifdef YYARENA
+#define NEW(size) yyarena_alloc(size)
+#else
+#define NEW(size) malloc(size)
+#endif
+
 struct ast {
   int type;
   struct ast *l;
@@ -49,7 +60,7 @@ struct numval {
 
 struct ast *newast(int type, struct ast *l, struct ast *r)
 {
-  struct ast *node = (struct ast *) malloc(sizeof(struct ast));
+  struct ast *node = (struct ast *) NEW(sizeof(struct ast));
   
   if (!node) {
     yyerror("out of memory\n");
@@ -64,7 +75,7 @@ struct ast *newast(int type, struct ast *l, struct ast *r)
 
 struct ast *newnum(double d)
 {
-  struct numval *node = malloc(sizeof(struct numval));
+  struct numval *node = NEW(sizeof(struct numval));
   
   if (!node) {
     yyerror("out of memory\n");
@@ -0,0 +1,4 @@
+#include "y.tab.h"
+
+#define YYACTION
+#define YYPARSER